@@ -8,6 +8,7 @@
 #define BOSON_BOSON_H_
 
 #include "engine.h"
+#include "file.h"
 #include "syscalls.h"
 #include "types.h"
 #include "utility.h"
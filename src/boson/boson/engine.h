@@ -4,17 +4,25 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <future>
 #include <memory>
+#include <mutex>
 #include <thread>
 #include <tuple>
 #include <vector>
 #include "internal/routine.h"
 #include "internal/thread.h"
+#include "internal/file_workers.h"
 #include "external/json_backbone.hpp"
 #include "queues/lcrq.h"
-#include "queues/mpsc.h"
+#include "memory/node_pool.h"
+#include "queues/intrusive_mpsc.h"
 #include "event_loop.h"
+#include "placement.h"
+#include "stacks.h"
+#include "statistics.h"
+#include "timers.h"
 
 namespace boson {
 
@@ -34,42 +42,92 @@ class engine : public event_handler {
   struct thread_view {
     thread_t thread;
     std::thread std_thread;
-    size_t nb_routines = 0;
     bool sent_end_request = false;
 
     inline thread_view(engine& engine) : thread{engine} {
     }
   };
 
-  enum class command_type { add_routine, notify_idle, notify_end_of_thread, fd_panic };
-
-  using command_new_routine_data = std::tuple<thread_id, std::unique_ptr<internal::routine>>;
-  using command_data = json_backbone::variant<std::nullptr_t, int, size_t, command_new_routine_data>;
+  enum class command_type { notify_idle, notify_end_of_thread, fd_panic };
 
+  /**
+   * Command sent to the engine, recycled like thread commands
+   */
   struct command {
-    thread_id from;
-    command_type type;
-    command_data data;
-    inline command(thread_id new_from, command_type new_type, command_data new_data)
-        : from{new_from}, type(new_type), data(std::move(new_data)) {
-    }
+    std::atomic<command*> next{nullptr};
+    memory::node_pool<command>* pool = nullptr;
+    thread_id from = 0;
+    command_type type = command_type::notify_idle;
+    int fd = -1;  // fd_panic
+  };
+
+  /**
+   * Command and routine node pools of a sender
+   *
+   * Each thread has its own, the last one is used by the thread owning
+   * the engine.
+   */
+  struct command_pools {
+    memory::node_pool<command> engine_commands;
+    memory::node_pool<command_t> thread_commands;
+    internal::routine_pool routines;
   };
 
   using thread_view_t = thread_view;
   using thread_list_t = std::vector<std::unique_ptr<thread_view_t>>;
 
   friend class internal::engine_proxy;
+  friend class internal::file_workers;
+  friend class thread_loads;
 
   std::size_t nb_active_threads_;
+
+  // Declared before the threads and the queues, which may still hold nodes when destroyed
+  std::vector<std::unique_ptr<command_pools>> command_pools_;
+
+  // Stacks given back by the threads, also declared before them
+  internal::stack_pool stack_pool_;
+
+  /**
+   * Generations of the fd numbers, bumped when they are closed
+   *
+   * Threads keep fds in their event loop until they are closed, maybe
+   * by another thread. Numbers share a fixed number of counters, a
+   * collision only costs a useless registration.
+   */
+  static constexpr std::size_t nb_fd_generations = 4096;
+  std::unique_ptr<std::atomic<std::uint32_t>[]> fd_generations_;
+
+  // Also declared before the threads, their inbox may hold its commands
+  internal::file_workers file_workers_;
+
   thread_list_t threads_;
   size_t max_nb_cores_;
   std::atomic<thread_id> current_thread_id_{0};
   std::atomic<routine_id> current_routine_id_{0};
 
-  // This is used to add routines from the external main thread
-  //
-  // Should not be used a lot.
-  thread_id next_scheduled_thread_{0};
+  /**
+   * Number of routines created and not yet finished
+   *
+   * Routines may migrate between threads through work stealing, so
+   * the engine cannot rely on per-thread counts to know when to end.
+   */
+  std::atomic<std::size_t> nb_live_routines_{0};
+
+  // Number of threads waiting for events with nothing to run
+  std::atomic<std::size_t> nb_idle_threads_{0};
+
+  /**
+   * Chooses the thread of routines started without an explicit one
+   */
+  std::unique_ptr<placement_policy> placement_;
+
+  // Read by the threads at each iteration
+  std::atomic<timer_resolution> timer_resolution_{timer_resolution::milliseconds};
+  std::atomic<clock_mode> clock_mode_{clock_mode::cached};
+  std::atomic<event_backend> event_backend_;
+  std::atomic<std::int64_t> busy_poll_us_{0};
+  std::atomic<std::size_t> max_file_workers_{4};
 
   /**
    * Registers a new thread
@@ -83,14 +141,35 @@ class engine : public event_handler {
   thread_id register_thread_id();
 
   //using queue_t = queues::lcrq;
-  using queue_t = queues::mpsc<std::unique_ptr<command>>;
+  using queue_t = queues::intrusive_mpsc<command>;
   queue_t command_queue_;
   std::condition_variable command_waiter_;
+  std::mutex command_mutex_;
   //event_loop command_loop_;
   //int self_event_id_;
   std::atomic<size_t> command_pushers_;
 
-  void push_command(thread_id from, std::unique_ptr<command> new_command);
+  void push_command(thread_id from, command* new_command);
+
+  /**
+   * Gets command nodes from the pools of the sender
+   *
+   * Must be called from the sender thread, from is max_nb_cores() for
+   * the thread owning the engine.
+   */
+  command* new_command(thread_id from, command_type type);
+  command_t* new_thread_command(thread_id from, internal::thread_command_type type);
+
+  /**
+   * Sends a new routine to its thread
+   *
+   * Routines go directly to the inbox of their thread, or to its run
+   * queue if it is the caller. The engine only counts them. If
+   * target_thread is max_nb_cores(), the placement policy chooses
+   * the thread, else the routine is pinned to target_thread.
+   */
+  void start_routine(thread_id from, thread_id target_thread,
+                     std::unique_ptr<internal::routine> new_routine);
   void execute_commands();
   void wait_all_routines();
 
@@ -107,15 +186,96 @@ class engine : public event_handler {
   void event(int event_id, void* data, event_status status) override;
   void read(int fd, void* data, event_status status) override;
   void write(int fd, void* data, event_status status) override;
+  void completion(void* data, event_status status) override;
 
   inline size_t max_nb_cores() const;
 
+  /**
+   * Replaces the placement policy
+   *
+   * Routines started without an explicit thread are placed by this
+   * policy. It must be set before starting routines, the default one
+   * is round_robin_placement.
+   */
+  void set_placement_policy(std::unique_ptr<placement_policy> policy);
+
+  /**
+   * Changes the resolution of timers and timeouts
+   *
+   * Timers registered before the change keep their deadline. The default
+   * resolution is timer_resolution::milliseconds.
+   */
+  void set_timer_resolution(timer_resolution resolution);
+  inline timer_resolution get_timer_resolution() const;
+
+  /**
+   * Changes the clock of boson::now() and timer deadlines
+   *
+   * The default mode is clock_mode::cached.
+   */
+  void set_clock_mode(clock_mode mode);
+  inline clock_mode get_clock_mode() const;
+
+  /**
+   * Changes the kernel interface of the event loops
+   *
+   * Threads switch at their next iteration, operations already submitted
+   * still complete. Threads whose kernel lacks io_uring keep using epoll.
+   * The default backend is event_backend::epoll, unless boson is built
+   * with BOSON_USE_IO_URING.
+   */
+  void set_event_backend(event_backend backend);
+  inline event_backend get_event_backend() const;
+
+  /**
+   * Makes idle threads spin before blocking in their event loop
+   *
+   * A thread with nothing to run polls its inbox and its event loop
+   * without waiting, for at most the given budget, which saves the
+   * latency of a wake up when work comes soon. Each thread halves its
+   * own budget when spinning finds nothing and doubles it back when it
+   * does, up to this maximum. Zero, the default, disables spinning.
+   */
+  void set_busy_poll(std::chrono::microseconds budget);
+  inline std::chrono::microseconds get_busy_poll() const;
+
+  /**
+   * Bounds the number of system threads running file syscalls
+   *
+   * Disk files cannot be polled, boson::file functions run them in
+   * workers started on demand. A lower limit only queues operations
+   * longer, workers already started keep running. The default is 4.
+   */
+  void set_max_file_workers(std::size_t max_nb_workers);
+  inline std::size_t get_max_file_workers() const;
+
+  /**
+   * Changes the sizing of the routine stack pools
+   *
+   * Must be called before starting routines.
+   */
+  void set_stack_pool_config(stack_pool_config const& config);
+
+  /**
+   * Returns the runtime counters, summed over every thread
+   */
+  engine_statistics statistics() const;
+
   /***
    * Starts a routine into the given thread
+   *
+   * Must be called from the thread owning the engine, routines use
+   * boson::start instead.
    */
   template <class Function, class... Args>
   void start(thread_id id, Function&& function, Args&&... args);
 
+  /**
+   * Starts a routine into the given thread, with a stack of the given class
+   */
+  template <class Function, class... Args>
+  void start(thread_id id, stack_size size, Function&& function, Args&&... args);
+
   /**
    * Starts a routine in whatever thread the engine sees fit
    */
@@ -128,6 +288,26 @@ inline size_t engine::max_nb_cores() const {
   return max_nb_cores_;
 }
 
+inline timer_resolution engine::get_timer_resolution() const {
+  return timer_resolution_.load(std::memory_order_relaxed);
+}
+
+inline clock_mode engine::get_clock_mode() const {
+  return clock_mode_.load(std::memory_order_relaxed);
+}
+
+inline event_backend engine::get_event_backend() const {
+  return event_backend_.load(std::memory_order_relaxed);
+}
+
+inline std::chrono::microseconds engine::get_busy_poll() const {
+  return std::chrono::microseconds(busy_poll_us_.load(std::memory_order_relaxed));
+}
+
+inline std::size_t engine::get_max_file_workers() const {
+  return max_file_workers_.load(std::memory_order_relaxed);
+}
+
 template <class Function, class... Args>
 engine::engine(size_t max_nb_cores, Function&& function, Args&&... args) : engine(max_nb_cores) {
   // Launch init routine
@@ -136,13 +316,17 @@ engine::engine(size_t max_nb_cores, Function&& function, Args&&... args) : engin
 
 template <class Function, class... Args>
 void engine::start(thread_id id, Function&& function, Args&&... args) {
-  // Send a request
-  push_command(max_nb_cores_, std::make_unique<command>(
-                                  max_nb_cores_, command_type::add_routine,
-                                  command_new_routine_data{id, std::make_unique<internal::routine>(
-                                                                   current_routine_id_++,
-                                                                   std::forward<Function>(function),
-                                                                   std::forward<Args>(args)...)}));
+  start(id, stack_size::medium, std::forward<Function>(function), std::forward<Args>(args)...);
+};
+
+template <class Function, class... Args>
+void engine::start(thread_id id, stack_size size, Function&& function, Args&&... args) {
+  start_routine(max_nb_cores_, id,
+                std::unique_ptr<internal::routine>(new (command_pools_[max_nb_cores_]->routines)
+                                                       internal::routine(
+                                                           current_routine_id_++, size,
+                                                           std::forward<Function>(function),
+                                                           std::forward<Args>(args)...)));
 };
 
 template <class Function, class... Args>
@@ -15,6 +15,45 @@ struct event_handler {
   virtual void event(int event_id, void* data, event_status status) = 0;
   virtual void read(int fd, void* data, event_status status) = 0;
   virtual void write(int fd, void* data, event_status status) = 0;
+
+  // An operation ended, with the syscall result or -errno
+  virtual void completion(void* data, event_status status) = 0;
+};
+
+/**
+ * Kernel interface waited on by the event loops
+ *
+ * With io_uring, syscalls which would block are handed over to the
+ * kernel as asynchronous operations, instead of being retried once their
+ * fd is ready. Loops fall back to epoll if the kernel does not support it.
+ */
+enum class event_backend { epoll, io_uring };
+
+enum class io_operation_type {
+  read,
+  write,
+  accept,
+  connect,
+  send,
+  recv,
+  readv,
+  writev,
+  sendmsg,
+  recvmsg,
+  fsync
+};
+
+/**
+ * Syscall submitted to an io_uring event loop
+ */
+struct io_operation {
+  io_operation_type type;
+  int fd;
+  void* buffer;                    // The address for accept and connect, the iovecs or msghdr
+  std::uint64_t size;              // The address length for connect, the number of iovecs
+  void* size_pointer = nullptr;    // The address length for accept
+  int flags = 0;                   // Of send, recv, sendmsg, recvmsg and accept
+  std::int64_t offset = -1;        // Of read, write, readv and writev, -1 is the file position
 };
 
 enum class loop_end_reason { max_iter_reached, timed_out, error_occured };
@@ -0,0 +1,35 @@
+#ifndef BOSON_FILE_H_
+#define BOSON_FILE_H_
+#pragma once
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <cstddef>
+#include "system.h"
+
+namespace boson {
+
+/**
+ * Syscalls on files on disk
+ *
+ * These files cannot be polled, a syscall on them blocks the whole
+ * thread with every routine on it. These functions run them in the file
+ * workers of the engine instead and suspend the routine meanwhile. A
+ * thread using io_uring submits pread, pwrite and fsync to its ring.
+ *
+ * They return like the POSIX functions, with errno set on failure, and
+ * have no timeout. They may only be called from a routine.
+ */
+namespace file {
+
+fd_t open(char const* path, int flags, mode_t mode = 0);
+ssize_t pread(fd_t fd, void* buffer, size_t count, off_t offset);
+ssize_t pwrite(fd_t fd, void const* buffer, size_t count, off_t offset);
+int fsync(fd_t fd);
+int stat(char const* path, struct stat* result);
+
+}  // namespace file
+}  // namespace boson
+
+#endif  // BOSON_FILE_H_
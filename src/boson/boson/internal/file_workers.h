@@ -0,0 +1,98 @@
+#ifndef BOSON_INTERNAL_FILE_WORKERS_H_
+#define BOSON_INTERNAL_FILE_WORKERS_H_
+#pragma once
+
+#include <sys/types.h>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "boson/event_loop.h"
+#include "boson/memory/node_pool.h"
+
+namespace boson {
+
+class engine;
+using thread_id = std::size_t;
+
+namespace internal {
+
+struct thread_command;
+
+enum class file_operation_type { open, pread, pwrite, fsync, stat };
+
+/**
+ * Blocking file syscall run by a file worker
+ */
+struct file_operation {
+  file_operation_type type;
+  int fd;
+  void* buffer;                 // The struct stat of stat
+  std::size_t size;
+  off_t offset = 0;
+  char const* path = nullptr;  // Of open and stat
+  int flags = 0;               // Of open
+  mode_t mode = 0;             // Of open
+};
+
+/**
+ * file_workers runs the file syscalls of the routines
+ *
+ * Files on disk cannot be polled, a syscall on them blocks the calling
+ * thread. The routines of an engine hand them to these system threads
+ * instead, started on demand up to the engine limit. Each worker takes
+ * a batch of operations and sends their results to every waiting
+ * thread with a single command, so one wake up resumes many routines.
+ */
+class file_workers {
+  struct job {
+    file_operation operation;
+    thread_id from;
+    std::size_t slot_index;
+  };
+
+  engine& engine_;
+  std::mutex mutex_;
+  std::condition_variable waiter_;
+  std::deque<job> jobs_;
+  std::size_t nb_idle_workers_ = 0;
+  bool stopping_ = false;
+
+  // One per worker, they outlive the workers since threads may still hold their nodes
+  std::vector<std::unique_ptr<memory::node_pool<thread_command>>> command_pools_;
+  std::vector<std::thread> workers_;
+
+  void work(std::size_t worker_index);
+
+ public:
+  // Operations a worker may take at once
+  static constexpr std::size_t max_batch_size = 64;
+
+  file_workers(engine& parent_engine);
+  file_workers(file_workers const&) = delete;
+  file_workers(file_workers&&) = delete;
+  file_workers& operator=(file_workers const&) = delete;
+  file_workers& operator=(file_workers&&) = delete;
+  ~file_workers();
+
+  /**
+   * Queues an operation, any thread of the engine
+   *
+   * Its result or -errno completes the given slot of the calling
+   * thread, through a complete_operations command.
+   */
+  void submit(file_operation const& operation, thread_id from, std::size_t slot_index);
+
+  /**
+   * Joins the workers once they ran every queued operation
+   */
+  void stop();
+};
+
+}  // namespace internal
+}  // namespace boson
+
+#endif  // BOSON_INTERNAL_FILE_WORKERS_H_
@@ -2,13 +2,20 @@
 #define BOSON_ROUTINE_H_
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <new>
+#include <type_traits>
+#include <typeinfo>
 #include <vector>
 #include "boson/std/experimental/apply.h"
 #include "boson/syscalls.h"
 #include "boson/utility.h"
-#include "boson/memory/local_ptr.h"
+#include "boson/memory/node_pool.h"
+#include "boson/memory/small_vector.h"
 #include "fcontext.h"
 #include "stack.h"
 #include "../event_loop.h"
@@ -26,11 +33,9 @@ class semaphore;
 namespace internal {
 class routine;
 class thread;
-class timed_routines_set;
 }
 
 using routine_ptr_t = std::unique_ptr<internal::routine>;
-using routine_local_ptr_t = memory::local_ptr<std::unique_ptr<internal::routine>>;
 
 namespace internal {
 /**
@@ -52,7 +57,7 @@ enum class routine_status {
 };
 
 using routine_time_point =
-    std::chrono::time_point<std::chrono::high_resolution_clock, std::chrono::milliseconds>;
+    std::chrono::time_point<std::chrono::high_resolution_clock, std::chrono::microseconds>;
 
 enum class event_type {
   none,
@@ -60,7 +65,8 @@ enum class event_type {
   io_read,
   io_write,
   sema_wait,
-  sema_closed
+  sema_closed,
+  io_operation
   //io_read_panic,
   //io_write_panic
 };
@@ -73,7 +79,7 @@ enum class fd_status {
 
 struct routine_timer_event_data {
   routine_time_point date;
-  timed_routines_set* neighbor_timers;
+  std::size_t timer;  // Handle in the timing wheel of the thread
 };
 
 struct routine_sema_event_data {
@@ -104,6 +110,10 @@ template <>
 struct is_small_type<boson::internal::routine_io_event> {
   constexpr static bool const value = true;
 };
+template <>
+struct is_small_type<boson::internal::routine_sema_event_data> {
+  constexpr static bool const value = true;
+};
 }
 
 namespace boson {
@@ -153,13 +163,32 @@ class function_holder_impl : public function_holder {
   }
 };
 
-template <class Function, class... Args>
-decltype(auto) make_unique_function_holder(Function&& func, Args&&... args) {
-  return std::unique_ptr<function_holder>(new function_holder_impl<std::decay_t<Function>, Args...>(
-      std::forward<Function>(func), std::forward<Args>(args)...));
+template <class Holder, class... Values>
+function_holder* emplace_function_holder(std::true_type, void* buffer, Values&&... values) {
+  return new (buffer) Holder(std::forward<Values>(values)...);
+}
+
+template <class Holder, class... Values>
+function_holder* emplace_function_holder(std::false_type, void*, Values&&... values) {
+  return new Holder(std::forward<Values>(values)...);
+}
+
+/**
+ * Builds the holder of a routine function in the given buffer, or on the heap if it does not fit
+ */
+template <std::size_t BufferSize, class Function, class... Args>
+function_holder* make_function_holder(void* buffer, Function&& func, Args&&... args) {
+  using holder_t = function_holder_impl<std::decay_t<Function>, Args...>;
+  using fits_t = std::integral_constant<bool, sizeof(holder_t) <= BufferSize &&
+                                                  alignof(holder_t) <= alignof(std::max_align_t)>;
+  return emplace_function_holder<holder_t>(fits_t{}, buffer, std::forward<Function>(func),
+                                           std::forward<Args>(args)...);
 }
 }  // namespace detail
 
+struct routine_block;
+using routine_pool = memory::node_pool<routine_block>;
+
 struct in_context_function {
   virtual ~in_context_function() = default;
   virtual void operator()(thread* this_thread) = 0;
@@ -177,8 +206,10 @@ struct queue_request {
 class routine {
   friend void detail::resume_routine(transfer_t);
   friend void boson::yield();
-  friend void boson::sleep(std::chrono::milliseconds);
+  friend void boson::sleep(std::chrono::microseconds);
   template <bool> friend int boson::wait_readiness(fd_t,int);
+  friend event_status boson::submit_operation(io_operation const&, int);
+  friend event_status boson::submit_file_operation(internal::file_operation const&);
   template <class ContentType>
   friend class channel;
   friend class thread;
@@ -189,44 +220,96 @@ class routine {
     routine_waiting_data data;
   };
 
-  std::unique_ptr<detail::function_holder> func_;
-  stack_context stack_ = allocate<default_stack_traits>();
+  // Small functions and their arguments are stored in the routine itself
+  static constexpr std::size_t inline_function_size = 64;
+  std::aligned_storage_t<inline_function_size, alignof(std::max_align_t)> inline_function_;
+  detail::function_holder* func_;
+  std::type_info const* function_type_;
+  stack_context stack_;  // Taken from the thread at the first resume
+  stack_size stack_size_;
   routine_status previous_status_ = routine_status::is_new;
   routine_status status_ = routine_status::is_new;
   transfer_t context_;
   thread* thread_;
   routine_id id_;
-  std::vector<waited_event> previous_events_;
-  std::vector<waited_event> events_;
-  routine_local_ptr_t current_ptr_;
+  memory::small_vector<waited_event, 4> events_;  // Larger selects spill over to the heap
   event_type happened_type_ = event_type::none;
   event_status happened_rc_ = 0;
   size_t happened_index_ = 0;
+  bool pinned_ = false;
+
+  /**
+   * Identifies the current event round
+   *
+   * Semaphore candidacies are queued with the round they were made for,
+   * outdated ones are ignored. While some are queued, the routine is
+   * neither deleted nor shared with other threads.
+   */
+  std::uint32_t event_round_ = 0;
+  std::size_t nb_candidacies_ = 0;
+
+  // Ends the current event round for the thread slots still referencing it
+  void invalidate_slots();
 
  public:
   template <class Function, class... Args>
-  routine(routine_id id, Function&& func, Args&&... args)
-      : func_{detail::make_unique_function_holder(std::forward<Function>(func),
-                                                  std::forward<Args>(args)...)},
+  routine(routine_id id, stack_size size, Function&& func, Args&&... args)
+      : func_{detail::make_function_holder<inline_function_size>(
+            &inline_function_, std::forward<Function>(func), std::forward<Args>(args)...)},
+        function_type_{&typeid(Function)},
+        stack_size_{size},
         id_{id} {
   }
 
+  template <class Function, class... Args>
+  routine(routine_id id, Function&& func, Args&&... args)
+      : routine(id, stack_size::medium, std::forward<Function>(func), std::forward<Args>(args)...) {
+  }
+
   routine(routine const&) = delete;
-  routine(routine&&) = default;
+  routine(routine&&) = delete;
   routine& operator=(routine const&) = delete;
-  routine& operator=(routine&&) = default;
+  routine& operator=(routine&&) = delete;
 
   ~routine();
 
+  /**
+   * Routines live in the pool of the thread creating them
+   *
+   * They go back to it when deleted, from any thread.
+   */
+  static void* operator new(std::size_t size, routine_pool& pool);
+  static void operator delete(void* pointer, routine_pool& pool);
+  static void operator delete(void* pointer);
+
   /**
    * Returns the current status
    */
   inline routine_id id() const;
+  inline stack_context const& stack() const;
   inline routine_status previous_status() const;
   inline routine_status status() const;
   inline routine_waiting_data& waiting_data();
   inline routine_waiting_data const& waiting_data() const;
 
+  /**
+   * Generation of the event round being waited on
+   *
+   * It lives in the pool block of the routine and changes whenever a
+   * round ends, so thread slots made for an older round, or for a
+   * previous routine of the same block, never match it.
+   */
+  inline std::uint64_t generation() const;
+
+  /**
+   * Pinned routines never leave the thread they have been started in
+   *
+   * Other routines may be stolen by idle threads when they are new
+   * or when they yield.
+   */
+  inline bool is_pinned() const;
+  inline void pin();
+
 
   // Clean up previous events and prepare routine to new set
   void start_event_round();
@@ -241,6 +324,21 @@ class routine {
 
   void add_write(int fd);
 
+  /**
+   * Submits a syscall to the io_uring of the thread
+   *
+   * It must be the only event of the round, its status is the syscall
+   * result or -errno.
+   */
+  void add_operation(io_operation const& operation, int timeout_ms);
+
+  /**
+   * Hands a file syscall to the workers of the engine
+   *
+   * Like add_operation, it must be the only event of the round.
+   */
+  void add_file_operation(file_operation const& operation);
+
   // Effectively commits the event set and suspends the routine
   size_t commit_event_round();
 
@@ -275,17 +373,42 @@ class routine {
    */
   inline event_type happened_type() const;
 
+  /**
+   * Returns the status of the event which happened
+   */
+  inline event_status happened_status() const;
+
   /**
    * Get the offset in the stack of the given pointer
    */
   std::size_t get_stack_offset(void* pointer);
 };
 
+/**
+ * Storage of a routine in a node pool
+ */
+struct routine_block {
+  std::atomic<routine_block*> next{nullptr};
+  routine_pool* pool = nullptr;
+  std::atomic<std::uint64_t> generation{0};  // Kept when the block is reused
+  std::aligned_storage_t<sizeof(routine), alignof(routine)> storage;
+};
+
 // Inline implementations
 routine_id routine::id() const {
   return id_;
 }
 
+stack_context const& routine::stack() const {
+  return stack_;
+}
+
+std::uint64_t routine::generation() const {
+  return reinterpret_cast<routine_block const*>(reinterpret_cast<char const*>(this) -
+                                                offsetof(routine_block, storage))
+      ->generation.load(std::memory_order_relaxed);
+}
+
 routine_status routine::previous_status() const {
   return previous_status_;
 }
@@ -294,6 +417,14 @@ routine_status routine::status() const {
   return status_;
 }
 
+bool routine::is_pinned() const {
+  return pinned_;
+}
+
+void routine::pin() {
+  pinned_ = true;
+}
+
 size_t routine::happened_index() const {
     return happened_index_;
 }
@@ -302,6 +433,10 @@ event_type routine::happened_type() const {
     return happened_type_;
 }
 
+event_status routine::happened_status() const {
+  return happened_rc_;
+}
+
 
 }  // namespace internal
 }  // namespace boson
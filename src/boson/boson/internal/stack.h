@@ -13,6 +13,7 @@ extern "C" {
 #include <cmath>
 #include <cstddef>
 #include <new>
+#include "boson/stacks.h"
 
 #if defined(BOSON_USE_VALGRIND)
 #include <valgrind/valgrind.h>
@@ -24,6 +25,7 @@ namespace internal {
 struct stack_context {
   std::size_t size{0};
   void* sp{nullptr};
+  std::size_t guard_size{0};  // Inaccessible memory below the stack
 #if defined(BOSON_USE_VALGRIND)
   unsigned valgrind_stack_id{0};
 #endif
@@ -39,49 +41,77 @@ struct basic_stack_traits {
 };
 
 // TODO: Those are unix specifics, to be defined elsewhere
+using small_stack_traits = basic_stack_traits<16 * 1024, 4 * 1024, 8 * 1024, false>;
 using default_stack_traits = basic_stack_traits<64 * 1024, 4 * 1024, 8 * 1024, false>;
+using large_stack_traits = basic_stack_traits<256 * 1024, 4 * 1024, 8 * 1024, false>;
+using huge_stack_traits = basic_stack_traits<1024 * 1024, 4 * 1024, 8 * 1024, false>;
 
+/**
+ * Makes the guard page at the start of a new stack mapping inaccessible
+ *
+ * Unmaps the stack and throws if the kernel refuses, a stack must not
+ * silently run without its guard.
+ */
+void protect(void* mapping, std::size_t mapped_size, std::size_t guard_size);
+
+/**
+ * Tells if stacks get guard pages with the given protection
+ */
+bool uses_guard_pages(stack_protection protection);
+
+/**
+ * Maps a stack with the given traits
+ *
+ * A protected stack gets a guard page below its usable size.
+ */
 template <class Traits>
-stack_context allocate() {
+stack_context allocate(bool is_protected = Traits::is_protected) {
+  std::size_t guard_size = is_protected ? Traits::page_size : 0;
+  std::size_t mapped_size = guard_size + Traits::stack_size;
 #if defined(MAP_ANON)
-  void* vp = ::mmap(0, Traits::stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+  void* vp = ::mmap(0, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
 #else
-  void* vp =
-      ::mmap(0, Traits::stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  void* vp = ::mmap(0, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 #endif
   if (MAP_FAILED == vp) throw std::bad_alloc();
 
-  // Will make use of C++17 constexpr if
-  if (Traits::is_protected) {
-#ifdef NDEBUG
-    ::mprotect(vp, Traits::page_size, PROT_NONE);
-#else
-    const int result(::mprotect(vp, Traits::page_size, PROT_NONE));
-    assert(0 == result);
-#endif
-  }
-
-  if (0 < Traits::locked_size) {
-  }
-  //// conforming to POSIX.1-200
-  //#if defined(BOOST_DISABLE_ASSERTS)
-  //::mprotect( vp, traits_type::page_size(), PROT_NONE);
-  //#else
-  // const int result( ::mprotect( vp, traits_type::page_size(), PROT_NONE) );
-  // BOOST_ASSERT( 0 == result);
-  //#endif
+  if (is_protected) protect(vp, mapped_size, guard_size);
 
   stack_context sctx;
   sctx.size = Traits::stack_size;
-  sctx.sp = static_cast<char*>(vp) + sctx.size;
+  sctx.guard_size = guard_size;
+  sctx.sp = static_cast<char*>(vp) + mapped_size;
 #if defined(BOSON_USE_VALGRIND)
-  sctx.valgrind_stack_id = VALGRIND_STACK_REGISTER(sctx.sp, vp);
+  sctx.valgrind_stack_id =
+      VALGRIND_STACK_REGISTER(sctx.sp, static_cast<char*>(vp) + guard_size);
 #endif
   return sctx;
 };
 
+/**
+ * Allocates a stack with the traits of the given size class
+ */
+stack_context allocate(stack_size size, stack_protection protection);
+
 void deallocate(stack_context& sctx) noexcept;
 
+/**
+ * Fills a stack with a canary pattern
+ */
+void paint(stack_context const& sctx) noexcept;
+
+/**
+ * Returns how many bytes of a painted stack have been overwritten
+ */
+std::size_t measure_usage(stack_context const& sctx) noexcept;
+
+/**
+ * Gives the memory of a stack back to the system, keeping its mapping
+ *
+ * The content of the stack is undefined afterwards.
+ */
+void release_memory(stack_context& sctx) noexcept;
+
 }  // namespace internal
 }  // namespace boson
 
@@ -0,0 +1,22 @@
+#ifndef BOSON_INTERNAL_STACK_GUARD_H_
+#define BOSON_INTERNAL_STACK_GUARD_H_
+#pragma once
+
+namespace boson {
+namespace internal {
+
+/**
+ * Makes the calling thread report the stack overflows of its routines
+ *
+ * This installs a SIGSEGV handler for the whole process, unless it is
+ * already there, and gives the thread an alternate signal stack, since
+ * the faulty one is unusable. A fault in the guard page of the running routine is
+ * reported on the standard error before aborting, other faults go to
+ * the previous handler.
+ */
+void watch_stack_overflows();
+
+}  // namespace internal
+}  // namespace boson
+
+#endif  // BOSON_INTERNAL_STACK_GUARD_H_
@@ -0,0 +1,113 @@
+#ifndef BOSON_INTERNAL_STACK_POOL_H_
+#define BOSON_INTERNAL_STACK_POOL_H_
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+#include "boson/stacks.h"
+#include "boson/statistics.h"
+#include "stack.h"
+
+namespace boson {
+namespace internal {
+
+/**
+ * stack_pool holds the stacks the threads of an engine gave back
+ *
+ * Thread safe, threads only go there in batches.
+ */
+class stack_pool {
+  stack_pool_config config_;
+  std::mutex mutex_;
+  std::array<std::vector<stack_context>, nb_stack_sizes> stacks_;
+
+ public:
+  stack_pool() = default;
+  stack_pool(stack_pool const&) = delete;
+  stack_pool(stack_pool&&) = delete;
+  stack_pool& operator=(stack_pool const&) = delete;
+  stack_pool& operator=(stack_pool&&) = delete;
+  ~stack_pool();
+
+  /**
+   * Changes the sizing of the pools
+   *
+   * Must be called before routines are started.
+   */
+  inline void set_config(stack_pool_config const& config);
+  inline stack_pool_config const& config() const;
+
+  /**
+   * Moves up to count stacks of the given class at the end of destination
+   */
+  void take(stack_size size, std::vector<stack_context>& destination, std::size_t count);
+
+  /**
+   * Moves the first count stacks of source in the pool of their class
+   *
+   * Stacks beyond the capacity are unmapped.
+   */
+  void give(stack_size size, std::vector<stack_context>& source, std::size_t count);
+};
+
+/**
+ * stack_cache is the stack pool of a single thread
+ *
+ * Stacks are reused in LIFO order, so that the most recently used, and
+ * thus resident, ones go first. When measuring usage, stacks are painted
+ * when taken and measured when given back.
+ */
+class stack_cache {
+  stack_pool& global_;
+  std::array<std::vector<stack_context>, nb_stack_sizes> stacks_;
+
+  // Single writer counters
+  std::atomic<std::size_t> nb_mapped_{0};
+  std::atomic<std::size_t> nb_reused_{0};
+
+  // Peak usages per function type, also read by other threads
+  mutable std::mutex usages_mutex_;
+  std::unordered_map<std::type_index, stack_usage> usages_;
+
+  void record_usage(stack_context const& stack, std::type_info const& function);
+
+ public:
+  stack_cache(stack_pool& global);
+  stack_cache(stack_cache const&) = delete;
+  stack_cache(stack_cache&&) = delete;
+  stack_cache& operator=(stack_cache const&) = delete;
+  stack_cache& operator=(stack_cache&&) = delete;
+  ~stack_cache();
+
+  stack_context allocate(stack_size size);
+
+  /**
+   * Takes back the stack of a routine which ran the given function type
+   */
+  void release(stack_size size, stack_context const& stack, std::type_info const& function);
+
+  /**
+   * Adds the cache counters to the given statistics
+   */
+  void add_statistics(engine_statistics& statistics) const;
+};
+
+// Inline implementations
+void stack_pool::set_config(stack_pool_config const& config) {
+  config_ = config;
+}
+
+stack_pool_config const& stack_pool::config() const {
+  return config_;
+}
+
+}  // namespace internal
+}  // namespace boson
+
+#endif  // BOSON_INTERNAL_STACK_POOL_H_
@@ -5,27 +5,29 @@
 #include <atomic>
 #include <cassert>
 #include <chrono>
+#include <cstdint>
 #include <deque>
 #include <map>
 #include <memory>
 #include <thread>
 #include <vector>
 #include "boson/event_loop.h"
-#include "boson/memory/local_ptr.h"
+#include "boson/placement.h"
+#include "boson/stacks.h"
+#include "boson/statistics.h"
+#include "boson/timers.h"
+#include "boson/memory/node_pool.h"
 #include "boson/memory/sparse_vector.h"
-#include "boson/queues/mpsc.h"
+#include "boson/queues/chase_lev.h"
+#include "boson/queues/intrusive_mpsc.h"
+#include "boson/queues/ring_buffer.h"
 #include "boson/queues/simple.h"
 #include "boson/queues/lcrq.h"
 #include "boson/queues/vectorized_queue.h"
+#include "file_workers.h"
 #include "routine.h"
-#include "../external/json_backbone.hpp"
-
-namespace json_backbone {
-template <>
-struct is_small_type<std::unique_ptr<boson::internal::routine>> {
-  constexpr static bool const value = true;
-};
-}
+#include "stack_pool.h"
+#include "timing_wheel.h"
 
 namespace boson {
 
@@ -42,17 +44,29 @@ enum class thread_status {
   finished    // Thread no longer executes a routine and is not required to wait
 };
 
-enum class thread_command_type { add_routine, schedule_waiting_routine, finish, fd_panic };
-
-using thread_command_data = json_backbone::variant<std::nullptr_t, int, routine_ptr_t, std::pair<std::weak_ptr<semaphore>, std::size_t>>;
-//using thread_command_data = json_backbone::variant<std::nullptr_t, int, routine_ptr_t, std::pair<semaphore*, routine*>>;
+enum class thread_command_type {
+  add_routine,
+  schedule_waiting_routine,
+  finish,
+  fd_panic,
+  complete_operations
+};
 
+/**
+ * Command sent to a thread
+ *
+ * Commands are intrusive nodes recycled by the pool of their sender, so
+ * steady state message passing does not allocate.
+ */
 struct thread_command {
-  thread_command_type type;
-  thread_command_data data;
-  inline thread_command(thread_command_type new_type, thread_command_data new_data)
-      : type(new_type), data(std::move(new_data)) {
-  }
+  std::atomic<thread_command*> next{nullptr};
+  memory::node_pool<thread_command>* pool = nullptr;
+  thread_command_type type = thread_command_type::finish;
+  routine* new_routine = nullptr;              // add_routine, owned by the command
+  std::weak_ptr<semaphore> waiting_semaphore;  // schedule_waiting_routine
+  std::size_t slot_index = 0;                  // schedule_waiting_routine
+  int fd = -1;                                 // fd_panic
+  std::vector<std::pair<std::size_t, event_status>> completions;  // complete_operations, by slot
 };
 
 /**
@@ -72,10 +86,36 @@ class engine_proxy final {
   void set_id();
   routine_id get_new_routine_id();
   void notify_end();
-  void notify_idle(size_t nb_suspended_routines);
+  void notify_idle();
+  void notify_routine_end();
+  void notify_idle_state(bool idle);
+  void wake_up_idle_thread();
+  std::size_t nb_idle_threads() const;
+  thread& get_thread(thread_id id);
   void start_routine(std::unique_ptr<routine> new_routine);
   void start_routine(thread_id target_thread, std::unique_ptr<routine> new_routine);
   void fd_panic(int fd);
+
+  /**
+   * Gets a command node from the pool of the current thread
+   */
+  thread_command* new_command(thread_command_type type);
+
+  // Returns the stack pool shared by the engine threads
+  stack_pool& get_stack_pool();
+
+  // Returns the pool of the routines created by the current thread
+  routine_pool& get_routine_pool();
+
+  // Returns the generation of the file behind a fd number
+  std::uint32_t get_fd_generation(int fd) const;
+
+  // Tells the other threads the fd number may be reused
+  void notify_fd_closed(int fd);
+
+  // Hands a file syscall to the workers of the engine
+  void submit_file_operation(file_operation const& operation, std::size_t slot_index);
+
   inline thread_id get_id() const {
     return current_thread_id_;
   }
@@ -84,15 +124,33 @@ class engine_proxy final {
   }
 };
 
-// Holds pointers to routines waiting for a time out
-struct timed_routines_set final {
-  std::size_t nb_active = 0;
-  std::deque<std::size_t> slots;
-};
-
+/**
+ * Reference from a thread slot to a routine waiting for an event
+ *
+ * Slots may outlive the event round they were made for, they only
+ * reach their routine while its generation did not change.
+ */
 struct routine_slot {
-  routine_local_ptr_t ptr;
+  routine* routine_ptr;
+  std::uint64_t generation;
   std::size_t event_index;
+
+  inline routine* get() const {
+    return routine_ptr && routine_ptr->generation() == generation ? routine_ptr : nullptr;
+  }
+};
+
+/**
+ * Entry of the local run queue
+ *
+ * The run queue owns the routine, unless the entry is a semaphore
+ * candidacy. Candidacies carry the event round they were made for, the
+ * routine ignores them once this round is over.
+ */
+struct scheduled_routine {
+  routine* routine_ptr;
+  std::uint32_t event_index;  // Semaphore candidacies only
+  std::uint32_t event_round;  // 0 when the run queue owns the routine
 };
 
 /**
@@ -102,7 +160,7 @@ struct routine_slot {
 class thread : public event_handler {
   friend void detail::resume_routine(transfer_t);
   friend void boson::yield();
-  friend void boson::sleep(std::chrono::milliseconds);
+  friend void boson::sleep(std::chrono::microseconds);
   template <bool> friend int boson::wait_readiness(fd_t,int);
   friend void boson::fd_panic(int fd);
   friend int boson::close(int);
@@ -111,12 +169,38 @@ class thread : public event_handler {
   friend class routine;
 
   friend class boson::semaphore;
-  using engine_queue_t = queues::mpsc<std::unique_ptr<thread_command>>;
-  //using engine_queue_t = queues::simple_queue<std::unique_ptr<thread_command>>;
-  //using engine_queue_t = queues::vectorized_queue<std::unique_ptr<thread_command>>; // NOT THREAD SAFE !!
+  using engine_queue_t = queues::intrusive_mpsc<thread_command>;
 
   engine_proxy engine_proxy_;
-  std::deque<routine_slot> scheduled_routines_;
+
+  // Stacks of the finished routines, for the next ones
+  stack_cache stack_cache_;
+
+  /**
+   * Run queue of the routines other threads may not steal
+   *
+   * Routines yielding during a round go to next_scheduled_routines_, both
+   * buffers are swapped at the end of the round.
+   */
+  queues::ring_buffer<scheduled_routine> scheduled_routines_;
+  queues::ring_buffer<scheduled_routine> next_scheduled_routines_;
+
+  /**
+   * Run queue of the routines other threads may steal
+   *
+   * New and yielding routines which are not pinned are stored here. The
+   * thread consumes it from the top, like thieves, to keep the FIFO
+   * scheduling order.
+   */
+  queues::chase_lev<routine*> stealable_routines_;
+
+  /**
+   * True when the thread has nothing to run and waits for events
+   *
+   * Threads with surplus work use it to wake a sibling up so it can steal.
+   */
+  std::atomic<bool> idle_{false};
+
   thread_status status_{thread_status::idle};
 
   /**
@@ -131,7 +215,7 @@ class thread : public event_handler {
    *
    * Useful to get it from the TLS
    */
-  routine* running_routine_;
+  routine* running_routine_ = nullptr;
 
   /**
    * Event loop managing interruptions
@@ -140,17 +224,42 @@ class thread : public event_handler {
 
   engine_queue_t engine_queue_;
   std::atomic<std::size_t> nb_pending_commands_{0};
+
+  /**
+   * True while the thread may block in its event loop
+   *
+   * Only the first pusher to reset it writes to the eventfd. While the
+   * thread is awake, it drains its inbox at each iteration instead.
+   */
+  std::atomic<bool> sleeping_{false};
+  std::atomic<std::size_t> nb_wakeups_sent_{0};
+  std::atomic<std::size_t> nb_wakeups_saved_{0};
   int engine_event_id_;
-  int self_event_id_;
 
+  // Engine settings, read once per iteration
+  timer_resolution timer_resolution_{timer_resolution::milliseconds};
+  clock_mode clock_mode_{clock_mode::cached};
+  bool uses_io_uring_{false};  // The engine asked for it and the kernel supports it
+
+  // Busy poll budgets in microseconds, the current one adapts up to the engine setting
+  std::int64_t busy_poll_max_{0};
+  std::int64_t busy_poll_budget_{0};
+  std::atomic<std::size_t> nb_busy_poll_hits_{0};
+  std::atomic<std::size_t> nb_busy_poll_misses_{0};
+  std::atomic<std::size_t> nb_file_operations_{0};
+  std::atomic<std::size_t> nb_file_batches_{0};
+
+  // Time at the start of the current iteration
+  std::chrono::high_resolution_clock::time_point now_;
 
   /**
-   * This map stores the timers
+   * This wheel stores the timers
    *
    * The idea here is to avoid additional fd creation just for timers, so we can create
-   * a whole lot of them without consuming the fd limit per process
+   * a whole lot of them without consuming the fd limit per process. Ticks are microseconds
+   * and values are indexes in suspended_slots_.
    */
-  std::map<routine_time_point, timed_routines_set> timed_routines_;
+  timing_wheel timers_;
 
   /**
    * Stores the number of suspended routines
@@ -163,6 +272,16 @@ class thread : public event_handler {
    */
   size_t nb_suspended_routines_{0};
 
+  /**
+   * Load counts published for placement policies
+   *
+   * Written once per scheduling round by the thread itself, read by
+   * any thread through load().
+   */
+  std::atomic<std::size_t> published_nb_scheduled_{0};
+  std::atomic<std::size_t> published_nb_suspended_{0};
+  std::atomic<std::size_t> published_nb_timers_{0};
+
   memory::sparse_vector<routine_slot> suspended_slots_;
 
   /**
@@ -192,9 +311,23 @@ class thread : public event_handler {
 
   inline transfer_t& context();
 
-  // Returns the set in which the routine has ben referenced
-  // used to decrement the set nb_active member when disabling the timer
-  timed_routines_set& register_timer(routine_time_point const& date, routine_slot slot);
+  // Returns the handle of the timer in the wheel, used to cancel it
+  timing_wheel::handle_t register_timer(routine_time_point const& date, routine_slot slot);
+
+  // Removes a timer which did not fire
+  void cancel_timer(timing_wheel::handle_t timer);
+
+  // Schedules the routines whose timers expired
+  void fire_timers();
+
+  /**
+   * Polls for work without blocking, for at most the busy poll budget
+   *
+   * The timeout, in microseconds, is the one of the coming wait, spinning
+   * never goes past it. Returns true if the thread has something to do,
+   * so that it does not need to wait.
+   */
+  bool busy_poll(std::int64_t timeout);
 
   // Returns the slot index used to push in the semaphore waiters queue
   std::size_t register_semaphore_wait(routine_slot slot);
@@ -211,6 +344,12 @@ class thread : public event_handler {
   //
   int register_write(int fd, routine_slot slot);
 
+  // Submits an operation to the io_uring of the event loop
+  void register_operation(io_operation const& operation, int timeout_ms, routine_slot slot);
+
+  // Submits a file syscall to the workers of the engine
+  void register_file_operation(file_operation const& operation, routine_slot slot);
+
   /**
    * Unregisters the given slot
    *
@@ -231,6 +370,34 @@ class thread : public event_handler {
    */
   void schedule(routine* routine);
 
+  /**
+   * Puts a routine into the stealable run queue
+   */
+  void share_routine(routine* shared_routine);
+
+  /**
+   * Steals routines from sibling threads
+   *
+   * Returns the number of routines stolen. At most half of the victim's
+   * run queue is taken.
+   */
+  std::size_t steal_routines();
+
+  /**
+   * Accounts for a routine which finished its execution
+   */
+  void routine_finished();
+
+  /**
+   * Enters or leaves the idle state
+   */
+  void set_idle(bool idle);
+
+  /**
+   * Publishes the current counts for load()
+   */
+  void publish_load();
+
  public:
   thread(engine& parent_engine);
   thread(thread const&) = delete;
@@ -246,9 +413,66 @@ class thread : public event_handler {
   void event(int event_id, void* data, event_status status) override;
   void read(int fd, void* data, event_status status) override;
   void write(int fd, void* data, event_status status) override;
+  void completion(void* data, event_status status) override;
 
   // called by engine
-  void push_command(thread_id from, std::unique_ptr<thread_command> command);
+  void push_command(thread_id from, thread_command* command);
+
+  /**
+   * Adds a new routine to the run queues
+   *
+   * Must be called from the thread itself, other threads send an
+   * add_routine command instead.
+   */
+  void schedule_new_routine(routine_ptr_t new_routine);
+
+  /**
+   * Interrupts the event loop wait, even without any command
+   *
+   * Used by busy siblings to make this thread steal their work
+   */
+  void wake_up();
+
+  /**
+   * Tries to get the thread out of the idle state
+   *
+   * Returns true if the caller is in charge of waking it up.
+   */
+  bool claim_idle();
+
+  /**
+   * Returns the last published load of the thread
+   *
+   * Thread safe, used by placement policies.
+   */
+  thread_load load() const;
+
+  /**
+   * Adds the thread counters to the given statistics
+   */
+  void add_statistics(engine_statistics& statistics) const;
+
+  /**
+   * Tells if the fd got ready since a syscall on it last would block
+   *
+   * Fds are registered in the event loop from their first use until
+   * they are closed. Their edges are kept until consumed, so a routine
+   * only waits for them when needed.
+   */
+  bool consume_readiness(int fd, bool is_read);
+
+  /**
+   * Tells that the error queue of the fd receives notifications
+   *
+   * EPOLLERR then wakes up its waiters like an edge, instead of
+   * interrupting them.
+   */
+  void watch_error_queue(int fd);
+
+  /**
+   * Tells if syscalls are submitted as io_uring operations
+   */
+  inline bool uses_io_uring() const;
 
   // called by engine
   // void execute_commands();
@@ -266,20 +490,22 @@ class thread : public event_handler {
    * Starts a new routine
    */
   template <class Function, class... Args>
-  void start_routine(Function&& func, Args&&... args) {
-    engine_proxy_.start_routine(std::make_unique<routine>(engine_proxy_.get_new_routine_id(),
-                                                          std::forward<Function>(func),
-                                                          std::forward<Args>(args)...));
+  void start_routine(stack_size size, Function&& func, Args&&... args) {
+    engine_proxy_.start_routine(std::unique_ptr<routine>(
+        new (engine_proxy_.get_routine_pool()) routine(engine_proxy_.get_new_routine_id(), size,
+                                                       std::forward<Function>(func),
+                                                       std::forward<Args>(args)...)));
   }
 
   /**
    * Starts a new routine in a specific thread
    */
   template <class Function, class... Args>
-  void start_routine_explicit(thread_id id, Function&& func, Args&&... args) {
+  void start_routine_explicit(thread_id id, stack_size size, Function&& func, Args&&... args) {
     engine_proxy_.start_routine(
-        id, std::make_unique<routine>(engine_proxy_.get_new_routine_id(),
-                                      std::forward<Function>(func), std::forward<Args>(args)...));
+        id, std::unique_ptr<routine>(new (engine_proxy_.get_routine_pool()) routine(
+                engine_proxy_.get_new_routine_id(), size, std::forward<Function>(func),
+                std::forward<Args>(args)...)));
   }
 
   /**
@@ -287,6 +513,11 @@ class thread : public event_handler {
    */
   inline routine* running_routine();
 
+  /**
+   * Returns the current time, according to the clock mode of the engine
+   */
+  inline std::chrono::high_resolution_clock::time_point now() const;
+
   /**
    * Returns a memory buffer suitable for a shared_buffer
    *
@@ -313,6 +544,14 @@ routine* thread::running_routine() {
   return running_routine_;
 }
 
+std::chrono::high_resolution_clock::time_point thread::now() const {
+  return clock_mode::cached == clock_mode_ ? now_ : std::chrono::high_resolution_clock::now();
+}
+
+bool thread::uses_io_uring() const {
+  return uses_io_uring_;
+}
+
 thread_id thread::id() const {
   return engine_proxy_.get_id();
 }
@@ -325,13 +564,32 @@ engine const& thread::get_engine() const {
 
 template <class Function, class... Args>
 void start_explicit(thread_id id, Function&& func, Args&&... args) {
-  internal::current_thread()->start_routine_explicit(id, std::forward<Function>(func),
-                                            std::forward<Args>(args)...);
+  internal::current_thread()->start_routine_explicit(id, stack_size::medium,
+                                                     std::forward<Function>(func),
+                                                     std::forward<Args>(args)...);
+}
+
+/**
+ * Starts a routine in a specific thread, with a stack of the given class
+ */
+template <class Function, class... Args>
+void start_explicit(thread_id id, stack_size size, Function&& func, Args&&... args) {
+  internal::current_thread()->start_routine_explicit(id, size, std::forward<Function>(func),
+                                                     std::forward<Args>(args)...);
 }
 
 template <class Function, class... Args>
 void start(Function&& func, Args&&... args) {
-  internal::current_thread()->start_routine(std::forward<Function>(func),
+  internal::current_thread()->start_routine(stack_size::medium, std::forward<Function>(func),
+                                            std::forward<Args>(args)...);
+}
+
+/**
+ * Starts a routine with a stack of the given class
+ */
+template <class Function, class... Args>
+void start(stack_size size, Function&& func, Args&&... args) {
+  internal::current_thread()->start_routine(size, std::forward<Function>(func),
                                             std::forward<Args>(args)...);
 }
 
@@ -0,0 +1,148 @@
+#ifndef BOSON_INTERNAL_TIMING_WHEEL_H_
+#define BOSON_INTERNAL_TIMING_WHEEL_H_
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include "boson/memory/sparse_vector.h"
+
+namespace boson {
+namespace internal {
+
+/**
+ * timing_wheel stores the timers of a thread
+ *
+ * Timers are kept in 5 levels of 64 slots, each slot of a level covering
+ * a whole turn of the level below. Insertion and cancellation are
+ * constant time, timers are moved down a level when the wheel reaches
+ * their slot, and a whole slot expires at once. Deadlines further than
+ * the 5 levels wait in an overflow list.
+ *
+ * Ticks are an arbitrary unit, the thread uses microseconds.
+ *
+ * Algorithm by George Varghese and Tony Lauck
+ * "Hashed and Hierarchical Timing Wheels" (SOSP 1987)
+ */
+class timing_wheel {
+ public:
+  using tick_t = std::uint64_t;
+  using handle_t = std::size_t;
+
+ private:
+  static constexpr std::size_t level_bits = 6;
+  static constexpr std::size_t nb_slots = 1 << level_bits;
+  static constexpr std::size_t nb_levels = 5;
+  static constexpr std::size_t overflow_bucket = nb_levels * nb_slots;
+  static constexpr std::size_t expiring_bucket = overflow_bucket + 1;
+  static constexpr handle_t none = std::numeric_limits<handle_t>::max();
+
+  struct node {
+    tick_t deadline;
+    handle_t previous;
+    handle_t next;
+    std::size_t bucket;
+    std::size_t value;
+  };
+
+  memory::sparse_vector<node> nodes_;
+  std::array<handle_t, expiring_bucket + 1> heads_;
+  std::array<handle_t, expiring_bucket + 1> tails_;  // Timers of a tick expire in order
+  std::array<std::uint64_t, nb_levels> occupied_slots_;
+  tick_t current_;  // Last tick expired, or next one to expire
+  std::size_t size_ = 0;
+
+  void link(handle_t handle, std::size_t bucket);
+  void unlink(handle_t handle);
+
+  // Links a node in the bucket matching its deadline
+  void place(handle_t handle);
+
+  // Moves down the timers of the slot of the given level the wheel just reached
+  void cascade(std::size_t level);
+
+  // Detaches the slot of the current tick to expire it
+  void take_current_slot();
+
+  // Jumps to the next tick which may need work, at most up to the given one
+  void skip_to(tick_t last);
+
+ public:
+  timing_wheel(tick_t now);
+  timing_wheel(timing_wheel const&) = delete;
+  timing_wheel(timing_wheel&&) = default;
+  timing_wheel& operator=(timing_wheel const&) = delete;
+  timing_wheel& operator=(timing_wheel&&) = default;
+
+  /**
+   * Adds a timer, deadlines already reached expire at the next advance
+   */
+  handle_t insert(tick_t deadline, std::size_t value);
+
+  /**
+   * Removes a timer which did not expire yet
+   */
+  void cancel(handle_t handle);
+
+  inline bool empty() const;
+  inline std::size_t size() const;
+  inline std::size_t value(handle_t handle) const;
+
+  /**
+   * Returns the first tick at which advance may have some work to do
+   *
+   * This is the deadline of the first timer if it is in the first level,
+   * a lower bound of it otherwise. The wheel must not be empty.
+   */
+  tick_t next_expiry() const;
+
+  /**
+   * Expires every timer whose deadline is before or equal to now
+   *
+   * The callback gets the value of each expired timer. It may insert
+   * or cancel timers, late ones wait for the next call.
+   */
+  template <class Callback>
+  void advance(tick_t now, Callback&& expire);
+};
+
+// Inline implementations
+bool timing_wheel::empty() const {
+  return 0 == size_;
+}
+
+std::size_t timing_wheel::size() const {
+  return size_;
+}
+
+std::size_t timing_wheel::value(handle_t handle) const {
+  return nodes_[handle].value;
+}
+
+template <class Callback>
+void timing_wheel::advance(tick_t now, Callback&& expire) {
+  while (0 < size_ && current_ <= now) {
+    take_current_slot();
+    // The wheel stays on now, so that late timers still land in a slot expired at the next call
+    bool last_tick = current_ == now;
+    if (!last_tick) ++current_;
+    // Expired timers are removed first so the callback may cancel the other ones
+    while (none != heads_[expiring_bucket]) {
+      handle_t handle = heads_[expiring_bucket];
+      std::size_t value = nodes_[handle].value;
+      unlink(handle);
+      nodes_.free(handle);
+      --size_;
+      expire(value);
+    }
+    if (last_tick) break;
+    if (0 < size_) skip_to(now);
+  }
+  if (current_ < now) current_ = now;
+}
+
+}  // namespace internal
+}  // namespace boson
+
+#endif  // BOSON_INTERNAL_TIMING_WHEEL_H_
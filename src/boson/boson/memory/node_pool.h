@@ -0,0 +1,85 @@
+#ifndef BOSON_MEMORY_NODE_POOL_H_
+#define BOSON_MEMORY_NODE_POOL_H_
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace boson {
+namespace memory {
+
+/**
+ * node_pool recycles fixed layout nodes sent to other threads
+ *
+ * Only the owner thread allocates, but any thread may release a node
+ * once it consumed it. Released nodes are pushed to a lock-free stack
+ * the owner takes back as a whole when its local free list is empty, so
+ * there is no ABA problem. Memory is only given back on destruction.
+ *
+ * Nodes must have a std::atomic<Node*> next member, used for both the
+ * free lists and the queues, and a node_pool<Node>* pool member.
+ */
+template <class Node>
+class node_pool {
+  static constexpr std::size_t chunk_size = 64;
+
+  // Only touched by the owner
+  Node* free_nodes_ = nullptr;
+  std::vector<std::unique_ptr<Node[]>> chunks_;
+
+  alignas(64) std::atomic<Node*> released_nodes_{nullptr};
+
+  void grow() {
+    chunks_.emplace_back(new Node[chunk_size]);
+    Node* chunk = chunks_.back().get();
+    for (std::size_t index = 0; index < chunk_size; ++index) {
+      chunk[index].pool = this;
+      chunk[index].next.store(index + 1 < chunk_size ? &chunk[index + 1] : nullptr,
+                              std::memory_order_relaxed);
+    }
+    free_nodes_ = chunk;
+  }
+
+ public:
+  node_pool() = default;
+  node_pool(node_pool const&) = delete;
+  node_pool(node_pool&&) = delete;
+  node_pool& operator=(node_pool const&) = delete;
+  node_pool& operator=(node_pool&&) = delete;
+
+  /**
+   * Gets a node, owner only
+   */
+  Node* allocate() {
+    if (nullptr == free_nodes_) free_nodes_ = released_nodes_.exchange(nullptr, std::memory_order_acquire);
+    if (nullptr == free_nodes_) grow();
+    Node* node = free_nodes_;
+    free_nodes_ = node->next.load(std::memory_order_relaxed);
+    node->next.store(nullptr, std::memory_order_relaxed);
+    return node;
+  }
+
+  /**
+   * Gives a node back to its pool, any thread
+   */
+  static void release(Node* node) {
+    node_pool* pool = node->pool;
+    Node* head = pool->released_nodes_.load(std::memory_order_relaxed);
+    do {
+      node->next.store(head, std::memory_order_relaxed);
+    } while (!pool->released_nodes_.compare_exchange_weak(head, node, std::memory_order_release,
+                                                          std::memory_order_relaxed));
+  }
+
+  /**
+   * Returns the number of nodes the pool created, owner only
+   */
+  inline std::size_t capacity() const {
+    return chunks_.size() * chunk_size;
+  }
+};
+
+}  // namespace memory
+}  // namespace boson
+
+#endif  // BOSON_MEMORY_NODE_POOL_H_
@@ -0,0 +1,122 @@
+#ifndef BOSON_MEMORY_SMALL_VECTOR_H_
+#define BOSON_MEMORY_SMALL_VECTOR_H_
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace boson {
+namespace memory {
+
+/**
+ * small_vector stores its first elements in itself
+ *
+ * Up to InlineSize elements, no memory is allocated. Beyond, every
+ * element spills over to a heap buffer which is kept until destruction,
+ * so a vector cleared and refilled the same way allocates only once.
+ */
+template <class ValueType, std::size_t InlineSize>
+class small_vector {
+  static_assert(0 < InlineSize, "small_vector needs some inline storage");
+  static_assert(alignof(ValueType) <= alignof(std::max_align_t),
+                "small_vector does not support over aligned types");
+
+  std::aligned_storage_t<sizeof(ValueType), alignof(ValueType)> inline_values_[InlineSize];
+  ValueType* data_;
+  std::size_t size_ = 0;
+  std::size_t capacity_ = InlineSize;
+
+  inline bool is_inline() const {
+    return data_ == reinterpret_cast<ValueType const*>(inline_values_);
+  }
+
+  void grow() {
+    std::size_t new_capacity = 2 * capacity_;
+    ValueType* new_data = static_cast<ValueType*>(::operator new(new_capacity * sizeof(ValueType)));
+    for (std::size_t index = 0; index < size_; ++index) {
+      new (new_data + index) ValueType(std::move(data_[index]));
+      data_[index].~ValueType();
+    }
+    if (!is_inline()) ::operator delete(data_);
+    data_ = new_data;
+    capacity_ = new_capacity;
+  }
+
+ public:
+  small_vector() : data_{reinterpret_cast<ValueType*>(inline_values_)} {
+  }
+  small_vector(small_vector const&) = delete;
+  small_vector(small_vector&&) = delete;
+  small_vector& operator=(small_vector const&) = delete;
+  small_vector& operator=(small_vector&&) = delete;
+
+  ~small_vector() {
+    clear();
+    if (!is_inline()) ::operator delete(data_);
+  }
+
+  template <class... Args>
+  ValueType& emplace_back(Args&&... args) {
+    if (size_ == capacity_) grow();
+    ValueType* value = new (data_ + size_) ValueType(std::forward<Args>(args)...);
+    ++size_;
+    return *value;
+  }
+
+  /**
+   * Destroys every element but keeps the storage
+   */
+  void clear() {
+    for (std::size_t index = 0; index < size_; ++index) data_[index].~ValueType();
+    size_ = 0;
+  }
+
+  inline std::size_t size() const {
+    return size_;
+  }
+
+  inline bool empty() const {
+    return 0 == size_;
+  }
+
+  inline std::size_t capacity() const {
+    return capacity_;
+  }
+
+  ValueType& operator[](std::size_t index) {
+    assert(index < size_);
+    return data_[index];
+  }
+
+  ValueType const& operator[](std::size_t index) const {
+    assert(index < size_);
+    return data_[index];
+  }
+
+  ValueType& back() {
+    assert(0 < size_);
+    return data_[size_ - 1];
+  }
+
+  ValueType* begin() {
+    return data_;
+  }
+
+  ValueType* end() {
+    return data_ + size_;
+  }
+
+  ValueType const* begin() const {
+    return data_;
+  }
+
+  ValueType const* end() const {
+    return data_ + size_;
+  }
+};
+
+}  // namespace memory
+}  // namespace boson
+
+#endif  // BOSON_MEMORY_SMALL_VECTOR_H_
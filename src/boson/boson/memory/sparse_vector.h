@@ -30,7 +30,7 @@ class sparse_vector {
 #endif
 
 #ifndef NDEBUG
-  inline bool has(std::size_t index) {
+  inline bool has(std::size_t index) const {
     return (index < data_.size() && last_free_cell_ != static_cast<int>(index) && free_cells_[index] == -1);
   }
 #endif
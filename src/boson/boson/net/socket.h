@@ -1,11 +1,24 @@
 #ifndef BOSON_NET_SOCKET_H_
 #define BOSON_NET_SOCKET_H_
 
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <vector>
+#include "boson/internal/thread.h"
+#include "boson/syscalls.h"
 #include "boson/system.h"
 
 namespace boson {
 namespace net {
 
+/**
+ * Creates a socket listening on every address of the host
+ *
+ * The domain is AF_INET or AF_INET6, receive_from only applies to IPv4.
+ * With reuse_port, other sockets can listen on the same port, the kernel
+ * then spreads the connections between them.
+ */
 socket_t create_listening_socket(
     int port,
     int max_connections = 1e5,
@@ -13,7 +26,76 @@ socket_t create_listening_socket(
     int type = SOCK_STREAM,
     int protocol = 0,
     int non_block = true,
-    in_addr_t receive_from=INADDR_ANY);
+    in_addr_t receive_from=INADDR_ANY,
+    bool reuse_port = false);
+
+namespace internal {
+// Returns the port a socket is bound to
+int bound_port(socket_t socket);
+
+// Returns the number of threads of the engine of the calling routine
+std::size_t nb_engine_threads();
+
+template <class Handler>
+void accept_connections(socket_t listener, Handler handler) {
+  using namespace std::chrono_literals;
+  thread_id self = boson::internal::current_thread()->id();
+  while (true) {
+    socket_t connection =
+        boson::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (0 <= connection) {
+      start_explicit(self, handler, connection);
+    } else if (EBADF == errno || EINVAL == errno) {
+      // Closed or shut down
+      break;
+    } else if (EMFILE == errno || ENFILE == errno || ENOBUFS == errno || ENOMEM == errno) {
+      // Pending connections wait in the backlog until resources are freed
+      boson::sleep(10ms);
+    }
+  }
+  boson::close(listener);
+}
+}  // namespace internal
+
+/**
+ * Accepts the connections of a port on every thread of the engine
+ *
+ * Each thread gets its own SO_REUSEPORT listening socket and accept
+ * routine, so connections are not all set up by the same thread. The
+ * handler is started as a routine for each connection, with its non
+ * blocking socket, pinned to the thread which accepted it. Port 0
+ * picks a free port for all the sockets.
+ *
+ * Returns the listening sockets. A socket shut down with ::shutdown
+ * ends its accept routine, which then closes it. Must be called from a
+ * routine.
+ */
+template <class Handler>
+std::vector<socket_t> listen_on_all_threads(int port, Handler handler, int domain = AF_INET,
+                                            int max_connections = 1e5) {
+  std::size_t nb_threads = internal::nb_engine_threads();
+  std::vector<socket_t> listeners;
+  for (std::size_t index = 0; index < nb_threads; ++index) {
+    listeners.push_back(create_listening_socket(port, max_connections, domain, SOCK_STREAM, 0,
+                                                true, INADDR_ANY, true));
+    if (0 == port) port = internal::bound_port(listeners.back());
+  }
+  for (std::size_t index = 0; index < nb_threads; ++index)
+    start_explicit(static_cast<thread_id>(index), internal::accept_connections<Handler>,
+                   listeners[index], handler);
+  return listeners;
+}
+
+/**
+ * Forwards data both ways between two sockets until both streams end
+ *
+ * Data moves through pipes with splice, it is never copied to user
+ * space. The end of a stream is forwarded with a write shutdown, and
+ * a failed transfer shuts both sockets down. Returns 0 once both
+ * streams ended, -1 with errno otherwise. The timeout applies to each
+ * wait. Must be called from a routine, the sockets are not closed.
+ */
+int proxy(socket_t fd_a, socket_t fd_b, int timeout_ms = -1);
 
 }  // namespace net
 }  // namespace boson
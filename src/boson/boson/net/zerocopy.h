@@ -0,0 +1,104 @@
+#ifndef BOSON_NET_ZEROCOPY_H_
+#define BOSON_NET_ZEROCOPY_H_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "boson/syscalls.h"
+#include "boson/system.h"
+
+namespace boson {
+namespace net {
+
+/**
+ * Sends data on a socket without copying it (MSG_ZEROCOPY)
+ *
+ * The kernel pins the buffer of a send instead of copying it, until
+ * the data is acknowledged. Each send gets an id, its buffer may only
+ * be modified or freed once wait() returned for this id or a later
+ * one. Completions come from the error queue of the socket.
+ *
+ * Pinning pages only pays off for large sends, around 10KB and more.
+ * The kernel may still copy the data, as on loopback. nb_copied() counts
+ * these sends.
+ */
+class zerocopy_sender {
+  socket_t socket_;
+  std::uint32_t next_id_{0};      // Ids are given by the kernel, in order
+  std::uint32_t released_id_{0};  // Every send before this id is released
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> early_ranges_;  // Released out of order
+  std::size_t nb_copied_{0};
+
+  void release(std::uint32_t first_id, std::uint32_t last_id);
+
+  /**
+   * Reads the completions of the error queue
+   *
+   * Returns the number of completions, or -1 on error.
+   */
+  int read_completions();
+
+ public:
+  /**
+   * Enables SO_ZEROCOPY on the socket
+   *
+   * Throws if the socket does not support it, like Unix sockets or a
+   * kernel older than 4.14.
+   */
+  explicit zerocopy_sender(socket_t socket);
+  zerocopy_sender(zerocopy_sender const&) = delete;
+  zerocopy_sender(zerocopy_sender&&) = default;
+  zerocopy_sender& operator=(zerocopy_sender const&) = delete;
+  zerocopy_sender& operator=(zerocopy_sender&&) = default;
+
+  /**
+   * Sends the buffer, like boson::send
+   *
+   * If some data was sent, last_id() is the id of this send.
+   */
+  ssize_t send(void const* buffer, size_t length, int flags = 0, int timeout_ms = -1);
+
+  // Id of the last send which sent some data
+  inline std::uint32_t last_id() const;
+
+  // Tells if the kernel released the buffer of the given send
+  inline bool released(std::uint32_t id) const;
+
+  /**
+   * Suspends the routine until the buffer of the given send is released
+   *
+   * Returns 0, or -1 with errno if the error queue could not be read
+   * or the timeout, which applies to each wait, expired.
+   */
+  int wait(std::uint32_t id, int timeout_ms = -1);
+
+  // Waits for every buffer sent so far
+  inline int wait_all(int timeout_ms = -1);
+
+  // Number of sends the kernel copied anyway
+  inline std::size_t nb_copied() const;
+};
+
+// Inline implementations
+
+std::uint32_t zerocopy_sender::last_id() const {
+  return next_id_ - 1;
+}
+
+bool zerocopy_sender::released(std::uint32_t id) const {
+  // Ids wrap around
+  return static_cast<std::int32_t>(id - released_id_) < 0;
+}
+
+int zerocopy_sender::wait_all(int timeout_ms) {
+  return next_id_ == released_id_ ? 0 : wait(last_id(), timeout_ms);
+}
+
+std::size_t zerocopy_sender::nb_copied() const {
+  return nb_copied_;
+}
+
+}  // namespace net
+}  // namespace boson
+
+#endif  // BOSON_NET_ZEROCOPY_H_
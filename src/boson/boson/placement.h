@@ -0,0 +1,117 @@
+#ifndef BOSON_PLACEMENT_H_
+#define BOSON_PLACEMENT_H_
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace boson {
+
+class engine;
+using thread_id = std::size_t;
+
+/**
+ * Load of a boson thread, as seen by placement policies
+ *
+ * Threads publish their counts once per scheduling round, so these
+ * are approximations. Pending commands are counted as soon as they are
+ * sent, which accounts for routines placed but not yet received.
+ */
+struct thread_load {
+  std::size_t nb_runnable;          // Routines scheduled for execution
+  std::size_t nb_suspended;         // Routines waiting for an fd or a semaphore
+  std::size_t nb_timers;            // Routines waiting for a timer
+  std::size_t nb_pending_commands;  // Commands not yet processed by the thread
+};
+
+/**
+ * Weights used to turn a thread_load into a single score
+ */
+struct load_weights {
+  std::size_t runnable = 4;
+  std::size_t suspended = 1;
+  std::size_t timers = 1;
+  std::size_t pending_commands = 4;
+
+  inline std::size_t score(thread_load const& load) const {
+    return runnable * load.nb_runnable + suspended * load.nb_suspended + timers * load.nb_timers +
+           pending_commands * load.nb_pending_commands;
+  }
+};
+
+/**
+ * Read only view over the loads of the engine threads
+ *
+ * Loads are read on demand, so a policy only pays for the threads it
+ * looks at. It can also be built from given loads, to see what a policy
+ * chooses outside of an engine.
+ */
+class thread_loads {
+  engine const* engine_ = nullptr;
+  std::vector<thread_load> loads_;
+
+ public:
+  inline thread_loads(engine const& parent_engine) : engine_{&parent_engine} {
+  }
+
+  inline thread_loads(std::vector<thread_load> loads) : loads_{std::move(loads)} {
+  }
+
+  std::size_t size() const;
+  thread_load operator[](thread_id id) const;
+};
+
+/**
+ * placement_policy chooses the thread of routines started without an explicit one
+ *
+ * A policy may be called concurrently, it must be thread safe.
+ */
+class placement_policy {
+ public:
+  virtual ~placement_policy() = default;
+  virtual thread_id place(thread_loads const& loads) = 0;
+};
+
+/**
+ * Assigns threads in turn, regardless of their load
+ *
+ * This is the default policy.
+ */
+class round_robin_placement : public placement_policy {
+  std::atomic<thread_id> next_thread_{0};
+
+ public:
+  thread_id place(thread_loads const& loads) override;
+};
+
+/**
+ * Picks the thread with the lowest weighted load
+ *
+ * All threads are looked at for each placement.
+ */
+class least_loaded_placement : public placement_policy {
+  load_weights weights_;
+
+ public:
+  least_loaded_placement(load_weights weights = {});
+  thread_id place(thread_loads const& loads) override;
+};
+
+/**
+ * Picks the less loaded of two random threads
+ *
+ * Nearly as good as least_loaded_placement, in constant time.
+ */
+class power_of_two_choices_placement : public placement_policy {
+  load_weights weights_;
+
+ public:
+  power_of_two_choices_placement(load_weights weights = {});
+  thread_id place(thread_loads const& loads) override;
+};
+
+}  // namespace boson
+
+#endif  // BOSON_PLACEMENT_H_
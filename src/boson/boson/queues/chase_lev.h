@@ -0,0 +1,159 @@
+#ifndef BOSON_QUEUES_CHASE_LEV_H_
+#define BOSON_QUEUES_CHASE_LEV_H_
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace boson {
+namespace queues {
+
+/**
+ * chase_lev is a lock-free work stealing deque
+ *
+ * The owner thread pushes and pops at the bottom, any other thread
+ * may steal at the top. The buffer grows when full, retired buffers are
+ * kept until destruction since thieves may still be reading them.
+ *
+ * Algorithm by Nhat Minh Le, Antoniu Pop, Albert Cohen, Francesco Zappa Nardelli
+ * "Correct and Efficient Work-Stealing for Weak Memory Models" (PPoPP 2013)
+ */
+template <class ContentType>
+class chase_lev {
+  static_assert(std::is_trivially_copyable<ContentType>::value,
+                "chase_lev only supports trivially copyable contents.");
+
+  struct circular_array {
+    std::int64_t const size;
+    std::unique_ptr<std::atomic<ContentType>[]> data;
+
+    circular_array(std::int64_t new_size)
+        : size{new_size}, data{new std::atomic<ContentType>[new_size]} {
+    }
+
+    inline ContentType get(std::int64_t index) const {
+      return data[index & (size - 1)].load(std::memory_order_relaxed);
+    }
+
+    inline void put(std::int64_t index, ContentType value) {
+      data[index & (size - 1)].store(value, std::memory_order_relaxed);
+    }
+  };
+
+  alignas(64) std::atomic<std::int64_t> top_;
+  alignas(64) std::atomic<std::int64_t> bottom_;
+  std::atomic<circular_array*> array_;
+
+  // Only touched by the owner
+  std::vector<std::unique_ptr<circular_array>> arrays_;
+
+  circular_array* grow(circular_array* current, std::int64_t bottom, std::int64_t top) {
+    arrays_.emplace_back(new circular_array(current->size * 2));
+    circular_array* bigger = arrays_.back().get();
+    for (std::int64_t index = top; index < bottom; ++index) bigger->put(index, current->get(index));
+    array_.store(bigger, std::memory_order_release);
+    return bigger;
+  }
+
+ public:
+  using content_type = ContentType;
+
+  /**
+   * Capacity is rounded up to the next power of two
+   */
+  chase_lev(std::size_t capacity = 64) : top_{0}, bottom_{0} {
+    std::int64_t size = 1;
+    while (size < static_cast<std::int64_t>(capacity)) size <<= 1;
+    arrays_.emplace_back(new circular_array(size));
+    array_.store(arrays_.back().get(), std::memory_order_relaxed);
+  }
+
+  chase_lev(chase_lev const&) = delete;
+  chase_lev(chase_lev&&) = delete;
+  chase_lev& operator=(chase_lev const&) = delete;
+  chase_lev& operator=(chase_lev&&) = delete;
+  ~chase_lev() = default;
+
+  /**
+   * Pushes at the bottom, owner only
+   */
+  void push(ContentType value) {
+    std::int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    std::int64_t top = top_.load(std::memory_order_acquire);
+    circular_array* array = array_.load(std::memory_order_relaxed);
+    if (array->size - 1 < bottom - top) array = grow(array, bottom, top);
+    array->put(bottom, value);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+  }
+
+  /**
+   * Pops at the bottom, owner only
+   *
+   * This is the LIFO end of the deque
+   */
+  bool pop(ContentType& value) {
+    std::int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    circular_array* array = array_.load(std::memory_order_relaxed);
+    bottom_.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t top = top_.load(std::memory_order_relaxed);
+    bool success = false;
+    if (top <= bottom) {
+      value = array->get(bottom);
+      success = true;
+      if (top == bottom) {
+        // Last element, race against thieves
+        success = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                               std::memory_order_relaxed);
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+      }
+    } else {
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return success;
+  }
+
+  /**
+   * Steals at the top, any thread
+   *
+   * This is the FIFO end of the deque. Returns false if the
+   * deque is empty or if another thief won the race.
+   */
+  bool steal(ContentType& value) {
+    std::int64_t top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t bottom = bottom_.load(std::memory_order_acquire);
+    if (top < bottom) {
+      circular_array* array = array_.load(std::memory_order_acquire);
+      ContentType candidate = array->get(top);
+      if (top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                       std::memory_order_relaxed)) {
+        value = candidate;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Returns an estimation of the number of elements
+   *
+   * The value is exact when called by the owner while no thief is active
+   */
+  std::size_t size() const {
+    std::int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    std::int64_t top = top_.load(std::memory_order_relaxed);
+    return static_cast<std::size_t>(top < bottom ? bottom - top : 0);
+  }
+
+  inline bool empty() const {
+    return 0 == size();
+  }
+};
+
+}  // namespace queues
+}  // namespace boson
+
+#endif  // BOSON_QUEUES_CHASE_LEV_H_
@@ -0,0 +1,77 @@
+#ifndef BOSON_QUEUES_INTRUSIVE_MPSC_H_
+#define BOSON_QUEUES_INTRUSIVE_MPSC_H_
+#include <atomic>
+
+namespace boson {
+namespace queues {
+
+/**
+ * intrusive_mpsc is a lock-free unbounded multiple producers single consumer queue
+ *
+ * Nodes are provided by the user and must have a std::atomic<Node*> next
+ * member. The queue never allocates, nor owns the nodes. A read may fail
+ * while a producer is in the middle of a write, the consumer is expected
+ * to retry later.
+ *
+ * Algorithm by Dmitry Vyukov
+ * http://www.1024cores.net/home/lock-free-algorithms/queues/intrusive-mpsc-node-based-queue
+ */
+template <class Node>
+class intrusive_mpsc {
+  alignas(64) std::atomic<Node*> head_;
+  alignas(64) Node* tail_;
+  Node stub_;
+
+ public:
+  intrusive_mpsc() : head_{&stub_}, tail_{&stub_} {
+    stub_.next.store(nullptr, std::memory_order_relaxed);
+  }
+
+  intrusive_mpsc(intrusive_mpsc const&) = delete;
+  intrusive_mpsc(intrusive_mpsc&&) = delete;
+  intrusive_mpsc& operator=(intrusive_mpsc const&) = delete;
+  intrusive_mpsc& operator=(intrusive_mpsc&&) = delete;
+
+  /**
+   * Pushes a node, any thread
+   */
+  void write(Node* node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Node* previous = head_.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+  }
+
+  /**
+   * Pops a node, consumer only
+   *
+   * Returns nullptr if the queue is empty or if a write is not complete yet
+   */
+  Node* read() {
+    Node* tail = tail_;
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &stub_) {
+      if (nullptr == next) return nullptr;
+      tail_ = next;
+      tail = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+    if (next) {
+      tail_ = next;
+      return tail;
+    }
+    if (tail != head_.load(std::memory_order_acquire)) return nullptr;
+    // Last node, put the stub back behind it so it can be detached
+    write(&stub_);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next) {
+      tail_ = next;
+      return tail;
+    }
+    return nullptr;
+  }
+};
+
+}  // namespace queues
+}  // namespace boson
+
+#endif  // BOSON_QUEUES_INTRUSIVE_MPSC_H_
@@ -0,0 +1,94 @@
+#ifndef BOSON_QUEUES_RING_BUFFER_H_
+#define BOSON_QUEUES_RING_BUFFER_H_
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace boson {
+namespace queues {
+
+/**
+ * ring_buffer is a single threaded FIFO queue over a contiguous array
+ *
+ * Capacity is a power of two and doubles when full. It never shrinks, so
+ * once warmed up the queue does not allocate any more.
+ */
+template <class ContentType>
+class ring_buffer {
+  static_assert(std::is_trivially_copyable<ContentType>::value,
+                "ring_buffer only supports trivially copyable contents.");
+
+  std::unique_ptr<ContentType[]> data_;
+  std::size_t capacity_;
+  std::size_t head_ = 0;  // Index of the first element
+  std::size_t size_ = 0;
+
+  void grow() {
+    std::unique_ptr<ContentType[]> bigger{new ContentType[capacity_ * 2]};
+    for (std::size_t index = 0; index < size_; ++index)
+      bigger[index] = data_[(head_ + index) & (capacity_ - 1)];
+    data_ = std::move(bigger);
+    capacity_ *= 2;
+    head_ = 0;
+  }
+
+ public:
+  using value_type = ContentType;
+
+  /**
+   * Capacity is rounded up to the next power of two
+   */
+  ring_buffer(std::size_t capacity = 64) : capacity_{1} {
+    while (capacity_ < capacity) capacity_ <<= 1;
+    data_.reset(new ContentType[capacity_]);
+  }
+
+  ring_buffer(ring_buffer const&) = delete;
+  ring_buffer(ring_buffer&&) = default;
+  ring_buffer& operator=(ring_buffer const&) = delete;
+  ring_buffer& operator=(ring_buffer&&) = default;
+
+  inline void push_back(ContentType value) {
+    if (size_ == capacity_) grow();
+    data_[(head_ + size_) & (capacity_ - 1)] = value;
+    ++size_;
+  }
+
+  inline ContentType const& front() const {
+    assert(0 < size_);
+    return data_[head_];
+  }
+
+  inline void pop_front() {
+    assert(0 < size_);
+    head_ = (head_ + 1) & (capacity_ - 1);
+    --size_;
+  }
+
+  inline std::size_t size() const {
+    return size_;
+  }
+
+  inline bool empty() const {
+    return 0 == size_;
+  }
+
+  inline std::size_t capacity() const {
+    return capacity_;
+  }
+
+  inline void swap(ring_buffer& other) {
+    using std::swap;
+    swap(data_, other.data_);
+    swap(capacity_, other.capacity_);
+    swap(head_, other.head_);
+    swap(size_, other.size_);
+  }
+};
+
+}  // namespace queues
+}  // namespace boson
+
+#endif  // BOSON_QUEUES_RING_BUFFER_H_
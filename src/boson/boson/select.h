@@ -228,14 +228,15 @@ auto make_selector_subscribe() -> decltype(auto) {
 template <class Func>
 internal::select_impl::event_timer_storage<Func> event_timer(int timeout_ms, Func&& cb) {
   return {std::forward<Func>(cb),
-          std::chrono::time_point_cast<std::chrono::milliseconds>(
-              std::chrono::high_resolution_clock::now() + std::chrono::milliseconds(timeout_ms))};
+          std::chrono::time_point_cast<std::chrono::microseconds>(
+              boson::now() + std::chrono::milliseconds(timeout_ms))};
 }
 
-template <class Func>
-internal::select_impl::event_timer_storage<Func> event_timer(std::chrono::milliseconds timeout, Func&& cb) {
-  return {std::forward<Func>(cb), std::chrono::time_point_cast<std::chrono::milliseconds>(
-                                      std::chrono::high_resolution_clock::now() + timeout)};
+template <class Rep, class Period, class Func>
+internal::select_impl::event_timer_storage<Func> event_timer(
+    std::chrono::duration<Rep, Period> timeout, Func&& cb) {
+  return {std::forward<Func>(cb), std::chrono::time_point_cast<std::chrono::microseconds>(
+                                      boson::now() + internal::ceil_microseconds(timeout))};
 }
 
 template <class Func> 
@@ -256,6 +257,12 @@ event_accept(socket_t socket, sockaddr* address, socklen_t* address_len, Func&&
     return {std::forward<Func>(cb), socket, address, address_len, 0};
 }
 
+template <class Func>
+internal::select_impl::event_syscall_storage<Func, SYS_accept4, socket_t, sockaddr*, socklen_t*, int>
+event_accept4(socket_t socket, sockaddr* address, socklen_t* address_len, int flags, Func&& cb) {
+    return {std::forward<Func>(cb), socket, address, address_len, flags, 0};
+}
+
 template <class Func> 
 internal::select_impl::event_syscall_storage<Func, SYS_write, fd_t, void*, size_t>
 event_write(fd_t fd, void* buf, size_t count, Func&& cb) {
@@ -268,6 +275,30 @@ event_send(fd_t fd, void* buf, size_t count, int flags, Func&& cb) {
     return {std::forward<Func>(cb),fd,buf,count,flags,nullptr,nullptr,0};
 }
 
+template <class Func>
+internal::select_impl::event_syscall_storage<Func, SYS_readv, fd_t, iovec const*, int>
+event_readv(fd_t fd, iovec const* buffers, int nb_buffers, Func&& cb) {
+    return {std::forward<Func>(cb), fd, buffers, nb_buffers, 0};
+}
+
+template <class Func>
+internal::select_impl::event_syscall_storage<Func, SYS_writev, fd_t, iovec const*, int>
+event_writev(fd_t fd, iovec const* buffers, int nb_buffers, Func&& cb) {
+    return {std::forward<Func>(cb), fd, buffers, nb_buffers, 0};
+}
+
+template <class Func>
+internal::select_impl::event_syscall_storage<Func, SYS_recvmsg, socket_t, msghdr*, int>
+event_recvmsg(socket_t socket, msghdr* message, int flags, Func&& cb) {
+    return {std::forward<Func>(cb), socket, message, flags, 0};
+}
+
+template <class Func>
+internal::select_impl::event_syscall_storage<Func, SYS_sendmsg, socket_t, msghdr const*, int>
+event_sendmsg(socket_t socket, msghdr const* message, int flags, Func&& cb) {
+    return {std::forward<Func>(cb), socket, message, flags, 0};
+}
+
 template <class Func> 
 internal::select_impl::event_syscall_storage<Func, SYS_connect, socket_t, const sockaddr*, socklen_t>
 event_connect(socket_t sockfd, const sockaddr *addr, socklen_t addrlen, Func&& cb) {
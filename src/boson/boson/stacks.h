@@ -0,0 +1,62 @@
+#ifndef BOSON_STACKS_H_
+#define BOSON_STACKS_H_
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace boson {
+
+/**
+ * Size class of a routine stack
+ *
+ * Each class has its own pools, the default one is stack_size::medium.
+ */
+enum class stack_size : std::uint8_t {
+  small,   // 16 KiB
+  medium,  // 64 KiB
+  large,   // 256 KiB
+  huge     // 1 MiB
+};
+
+static constexpr std::size_t nb_stack_sizes = 4;
+
+/**
+ * Protection of the routine stacks against overflows
+ *
+ * With guard pages, each stack is preceded by an inaccessible page. A
+ * routine overflowing into it is reported, with its id and stack size,
+ * and the process aborts. Otherwise, an overflow silently corrupts the
+ * memory below the stack.
+ *
+ * Before Linux 6.13, every guard page is a separate mapping of the
+ * process. With the default vm.max_map_count, this caps a process
+ * around 32k routines, so automatic, the default, only uses guard pages
+ * on kernels where they are free.
+ */
+enum class stack_protection { none, guard_page, automatic };
+
+/**
+ * Sizing of the routine stack pools
+ *
+ * Each thread keeps the stacks of finished routines for its next ones.
+ * Above its high watermark, a thread gives stacks back to a pool shared
+ * by the engine threads, until it only keeps its low watermark. The
+ * memory of these stacks is released to the system, but their mappings
+ * are kept for reuse, up to the global capacity.
+ *
+ * Every stack size class is counted separately.
+ */
+struct stack_pool_config {
+  std::size_t thread_high_watermark = 256;
+  std::size_t thread_low_watermark = 64;
+  std::size_t global_capacity = 4096;
+  stack_protection protection = stack_protection::automatic;
+
+  // Paints stacks to measure their peak usage, see engine_statistics
+  bool measure_usage = false;
+};
+
+}  // namespace boson
+
+#endif  // BOSON_STACKS_H_
@@ -0,0 +1,71 @@
+#ifndef BOSON_STATISTICS_H_
+#define BOSON_STATISTICS_H_
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace boson {
+
+static constexpr std::size_t nb_stack_usage_buckets = 11;
+
+/**
+ * Peak stack usage of the routines of a function type
+ *
+ * Each lambda has its own type, so this is also a measure per spawn
+ * site. Bucket i of the histogram counts the routines which used at
+ * most 1 KiB << i, the last one counting every bigger usage too.
+ */
+struct stack_usage {
+  std::string function;  // Demangled type name
+  std::size_t nb_routines = 0;
+  std::size_t max_bytes = 0;
+  std::array<std::size_t, nb_stack_usage_buckets> histogram{};
+};
+
+/**
+ * Runtime counters of an engine
+ *
+ * Counters are summed over every thread and read without
+ * synchronization, they are meant for monitoring and benchmarks.
+ */
+struct engine_statistics {
+  // Cross thread wake ups which needed a syscall
+  std::size_t nb_wakeups_sent = 0;
+
+  // Cross thread wake ups avoided because the target thread was awake
+  std::size_t nb_wakeups_saved = 0;
+
+  // Routine stacks mapped from the system
+  std::size_t nb_stacks_mapped = 0;
+
+  // Routine stacks taken from a pool
+  std::size_t nb_stacks_reused = 0;
+
+  // Fds registered in the event loops, each one costs an epoll_ctl
+  std::size_t nb_fd_registrations = 0;
+
+  // Syscalls submitted to io_uring instead of being retried on readiness
+  std::size_t nb_io_operations = 0;
+
+  // Busy polls which found some work before their budget ran out
+  std::size_t nb_busy_poll_hits = 0;
+
+  // Busy polls which ran out of budget, the thread then blocked
+  std::size_t nb_busy_poll_misses = 0;
+
+  // File syscalls run by the file workers
+  std::size_t nb_file_operations = 0;
+
+  // Commands which brought their results back, each one resumes a batch of routines
+  std::size_t nb_file_batches = 0;
+
+  // Finished routines, when stack_pool_config::measure_usage is set
+  std::vector<stack_usage> stack_usages;
+};
+
+}  // namespace boson
+
+#endif  // BOSON_STATISTICS_H_
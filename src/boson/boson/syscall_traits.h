@@ -3,10 +3,12 @@
 
 #include <sys/socket.h>
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <utility>
 #include <sys/syscall.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include "internal/routine.h"
 #include "system.h"
 #include "std/experimental/apply.h"
@@ -45,24 +47,98 @@ template <> struct add_event<false> {
 
 template <int SyscallId> struct syscall_traits;
 
+/**
+ * Readiness and io_uring operation of a syscall
+ *
+ * operation() takes the syscall arguments and builds its io_uring
+ * equivalent. Syscalls without one only wait for readiness.
+ */
 template <> struct syscall_traits<SYS_read> {
   static constexpr bool is_read = true;
+  static inline io_operation operation(int fd, void* buffer, size_t count) {
+    return {io_operation_type::read, fd, buffer, count};
+  }
 };
 
 template <> struct syscall_traits<SYS_write> {
   static constexpr bool is_read = false;
+  static inline io_operation operation(int fd, void const* buffer, size_t count) {
+    return {io_operation_type::write, fd, const_cast<void*>(buffer), count};
+  }
 };
 
 template <> struct syscall_traits<SYS_recvfrom> {
   static constexpr bool is_read = true;
+  static inline io_operation operation(int fd, void* buffer, size_t length, int flags,
+                                       std::nullptr_t, int) {
+    return {io_operation_type::recv, fd, buffer, length, nullptr, flags};
+  }
 };
 
 template <> struct syscall_traits<SYS_sendto> {
   static constexpr bool is_read = false;
+  static inline io_operation operation(int fd, void const* buffer, size_t length, int flags,
+                                       std::nullptr_t, int) {
+    return {io_operation_type::send, fd, const_cast<void*>(buffer), length, nullptr, flags};
+  }
+};
+
+template <> struct syscall_traits<SYS_readv> {
+  static constexpr bool is_read = true;
+  static inline io_operation operation(int fd, iovec const* buffers, int nb_buffers) {
+    return {io_operation_type::readv, fd, const_cast<iovec*>(buffers),
+            static_cast<std::uint64_t>(nb_buffers)};
+  }
+};
+
+template <> struct syscall_traits<SYS_writev> {
+  static constexpr bool is_read = false;
+  static inline io_operation operation(int fd, iovec const* buffers, int nb_buffers) {
+    return {io_operation_type::writev, fd, const_cast<iovec*>(buffers),
+            static_cast<std::uint64_t>(nb_buffers)};
+  }
+};
+
+template <> struct syscall_traits<SYS_recvmsg> {
+  static constexpr bool is_read = true;
+  static inline io_operation operation(int fd, msghdr* message, int flags) {
+    return {io_operation_type::recvmsg, fd, message, 0, nullptr, flags};
+  }
+};
+
+template <> struct syscall_traits<SYS_sendmsg> {
+  static constexpr bool is_read = false;
+  static inline io_operation operation(int fd, msghdr const* message, int flags) {
+    return {io_operation_type::sendmsg, fd, const_cast<msghdr*>(message), 0, nullptr, flags};
+  }
+};
+
+// Without io_uring equivalent
+template <> struct syscall_traits<SYS_recvmmsg> {
+  static constexpr bool is_read = true;
+};
+
+template <> struct syscall_traits<SYS_sendmmsg> {
+  static constexpr bool is_read = false;
+};
+
+template <> struct syscall_traits<SYS_sendfile> {
+  static constexpr bool is_read = false;
 };
 
 template <> struct syscall_traits<SYS_accept> {
   static constexpr bool is_read = true;
+  static inline io_operation operation(int fd, sockaddr* address, socklen_t* address_length) {
+    return {io_operation_type::accept, fd, address, 0, address_length};
+  }
+};
+
+template <> struct syscall_traits<SYS_accept4> {
+  static constexpr bool is_read = true;
+  static inline io_operation operation(int fd, sockaddr* address, socklen_t* address_length,
+                                       int flags) {
+    return {io_operation_type::accept, fd, address, 0, address_length, flags};
+  }
 };
 
 template <> struct syscall_traits<SYS_connect> {
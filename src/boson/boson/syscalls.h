@@ -1,11 +1,15 @@
 #ifndef BOSON_SYSCALLS_H_
 #define BOSON_SYSCALLS_H_
 
+#include <fcntl.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <chrono>
 #include <cstdint>
 #include <utility>
+#include "event_loop.h"
 #include "system.h"
+#include "timers.h"
 
 namespace boson {
 /**
@@ -18,22 +22,104 @@ void yield();
 
 /**
  * Suspends the routine for the given duration
+ *
+ * With the default timer resolution, the deadline is truncated to the
+ * millisecond.
  */
-void sleep(std::chrono::milliseconds duration);
+void sleep(std::chrono::microseconds duration);
+
+template <class Rep, class Period>
+inline void sleep(std::chrono::duration<Rep, Period> duration) {
+  sleep(internal::ceil_microseconds(duration));
+}
+
+/**
+ * Returns the current time, as seen by the scheduler
+ *
+ * In a routine, this is the clock of its thread, refreshed once per
+ * scheduler iteration unless the engine uses clock_mode::precise.
+ * Elsewhere, this reads the system clock. Timer deadlines are computed
+ * from it.
+ */
+std::chrono::high_resolution_clock::time_point now();
 
 /**
  * Suspends the routine until the fd is ready for a syscall
+ *
+ * Returns at once if the fd got ready since the last time it would
+ * block, without any syscall.
  */
 template <bool IsARead> int wait_readiness(fd_t fd, int timeout_ms);
 
+/**
+ * Suspends the routine until the io_uring operation completes
+ *
+ * Returns the syscall result or -errno. -EAGAIN means the kernel could
+ * not wait for the fd, the syscall must then wait for its readiness.
+ */
+event_status submit_operation(io_operation const& operation, int timeout_ms);
+
+namespace internal {
+struct file_operation;
+}
+
+/**
+ * Suspends the routine until a file worker of the engine ran the syscall
+ *
+ * Returns the syscall result or -errno.
+ */
+event_status submit_file_operation(internal::file_operation const& operation);
+
 // Boson equivalents to POSIX systemcalls
 
 ssize_t read(fd_t fd, void *buf, size_t count, int timeout_ms = -1);
 ssize_t write(fd_t fd, const void *buf, size_t count, int timeout_ms = -1);
 socket_t accept(socket_t socket, sockaddr *address, socklen_t *address_len, int timeout_ms = -1);
+socket_t accept4(socket_t socket, sockaddr *address, socklen_t *address_len, int flags,
+                 int timeout_ms = -1);
 int connect(socket_t sockfd, const sockaddr *addr, socklen_t addrlen, int timeout_ms = -1);
 ssize_t send(socket_t socket, const void *buffer, size_t length, int flags, int timeout_ms = -1);
 ssize_t recv(socket_t socket, void *buffer, size_t length, int flags, int timeout_ms = -1);
+ssize_t sendto(socket_t socket, const void *buffer, size_t length, int flags,
+               sockaddr const *address, socklen_t address_len, int timeout_ms = -1);
+ssize_t recvfrom(socket_t socket, void *buffer, size_t length, int flags, sockaddr *address,
+                 socklen_t *address_len, int timeout_ms = -1);
+
+/**
+ * Sends or receives several datagrams in a single syscall
+ *
+ * Like the syscalls, returns the number of messages transferred, each
+ * message length is in its msg_len field. recvmmsg only waits for the
+ * first datagram, then drains up to nb_messages of them.
+ */
+int sendmmsg(socket_t socket, mmsghdr *messages, unsigned int nb_messages, int flags,
+             int timeout_ms = -1);
+int recvmmsg(socket_t socket, mmsghdr *messages, unsigned int nb_messages, int flags,
+             int timeout_ms = -1);
+
+ssize_t readv(fd_t fd, iovec const *buffers, int nb_buffers, int timeout_ms = -1);
+ssize_t writev(fd_t fd, iovec const *buffers, int nb_buffers, int timeout_ms = -1);
+ssize_t sendmsg(socket_t socket, msghdr const *message, int flags, int timeout_ms = -1);
+ssize_t recvmsg(socket_t socket, msghdr *message, int flags, int timeout_ms = -1);
+
+/**
+ * Copies data from a file to a socket in the kernel
+ *
+ * The routine waits for the socket to be writable, like send.
+ */
+ssize_t sendfile(socket_t out_fd, fd_t in_fd, off_t *offset, size_t count, int timeout_ms = -1);
+
+/**
+ * Moves data between a pipe and another fd in the kernel
+ *
+ * SPLICE_F_NONBLOCK is always added, the routine waits for the end that
+ * would block instead, so the pipes may be blocking ones.
+ */
+ssize_t splice(fd_t fd_in, loff_t *off_in, fd_t fd_out, loff_t *off_out, size_t length,
+               unsigned int flags, int timeout_ms = -1);
+
+// Duplicates data between two pipes in the kernel, waits like splice
+ssize_t tee(fd_t fd_in, fd_t fd_out, size_t length, unsigned int flags, int timeout_ms = -1);
 
 // Versions with C++11 durations
 
@@ -49,6 +135,11 @@ inline socket_t accept(socket_t socket, sockaddr *address, socklen_t *address_le
     return accept(socket, address, address_len, timeout.count());
 }
 
+inline socket_t accept4(socket_t socket, sockaddr *address, socklen_t *address_len, int flags,
+                        std::chrono::milliseconds timeout) {
+  return accept4(socket, address, address_len, flags, timeout.count());
+}
+
 inline int connect(socket_t sockfd, const sockaddr *addr, socklen_t addrlen, std::chrono::milliseconds timeout) {
   return connect(sockfd, addr, addrlen, timeout.count());
 }
@@ -62,6 +153,94 @@ inline ssize_t recv(socket_t socket, void *buffer, size_t length, int flags, std
   return recv(socket, buffer, length, flags, timeout.count());
 }
 
+inline ssize_t sendto(socket_t socket, const void *buffer, size_t length, int flags,
+                      sockaddr const *address, socklen_t address_len,
+                      std::chrono::milliseconds timeout) {
+  return sendto(socket, buffer, length, flags, address, address_len, timeout.count());
+}
+
+inline ssize_t recvfrom(socket_t socket, void *buffer, size_t length, int flags, sockaddr *address,
+                        socklen_t *address_len, std::chrono::milliseconds timeout) {
+  return recvfrom(socket, buffer, length, flags, address, address_len, timeout.count());
+}
+
+inline int sendmmsg(socket_t socket, mmsghdr *messages, unsigned int nb_messages, int flags,
+                    std::chrono::milliseconds timeout) {
+  return sendmmsg(socket, messages, nb_messages, flags, timeout.count());
+}
+
+inline int recvmmsg(socket_t socket, mmsghdr *messages, unsigned int nb_messages, int flags,
+                    std::chrono::milliseconds timeout) {
+  return recvmmsg(socket, messages, nb_messages, flags, timeout.count());
+}
+
+inline ssize_t readv(fd_t fd, iovec const *buffers, int nb_buffers,
+                     std::chrono::milliseconds timeout) {
+  return readv(fd, buffers, nb_buffers, timeout.count());
+}
+
+inline ssize_t writev(fd_t fd, iovec const *buffers, int nb_buffers,
+                      std::chrono::milliseconds timeout) {
+  return writev(fd, buffers, nb_buffers, timeout.count());
+}
+
+inline ssize_t sendmsg(socket_t socket, msghdr const *message, int flags,
+                       std::chrono::milliseconds timeout) {
+  return sendmsg(socket, message, flags, timeout.count());
+}
+
+inline ssize_t recvmsg(socket_t socket, msghdr *message, int flags,
+                       std::chrono::milliseconds timeout) {
+  return recvmsg(socket, message, flags, timeout.count());
+}
+
+inline ssize_t sendfile(socket_t out_fd, fd_t in_fd, off_t *offset, size_t count,
+                        std::chrono::milliseconds timeout) {
+  return sendfile(out_fd, in_fd, offset, count, timeout.count());
+}
+
+inline ssize_t splice(fd_t fd_in, loff_t *off_in, fd_t fd_out, loff_t *off_out, size_t length,
+                      unsigned int flags, std::chrono::milliseconds timeout) {
+  return splice(fd_in, off_in, fd_out, off_out, length, flags, timeout.count());
+}
+
+inline ssize_t tee(fd_t fd_in, fd_t fd_out, size_t length, unsigned int flags,
+                   std::chrono::milliseconds timeout) {
+  return tee(fd_in, fd_out, length, flags, timeout.count());
+}
+
+/**
+ * Skips the given number of bytes at the start of a buffer array
+ *
+ * Buffers fully consumed are skipped and the next one is shortened, in
+ * place. Returns the number of buffers left, buffers then points to the
+ * first one.
+ */
+int advance_buffers(iovec *&buffers, int nb_buffers, std::size_t nb_bytes);
+
+/**
+ * Writes every buffer, continuing after partial writes
+ *
+ * The buffers are modified as data is written. Returns the number of
+ * bytes written, or -1 if an error or the timeout, which applies to
+ * each wait, stopped the writes.
+ */
+ssize_t writev_all(fd_t fd, iovec *buffers, int nb_buffers, int timeout_ms = -1);
+
+/**
+ * Sends the whole message, continuing after partial sends
+ *
+ * Only the buffers of the message are modified, the ancillary data is
+ * only sent with the first part. Returns like writev_all.
+ */
+ssize_t sendmsg_all(socket_t socket, msghdr *message, int flags, int timeout_ms = -1);
+
+/**
+ * Closes a fd used by routines
+ *
+ * Fds stay registered in the event loops until they are closed, they
+ * must be closed through this function for their number to be reused.
+ */
 int close(int fd);
 void fd_panic(int fd);
 
@@ -0,0 +1,41 @@
+#ifndef BOSON_TIMERS_H_
+#define BOSON_TIMERS_H_
+#pragma once
+
+#include <chrono>
+
+namespace boson {
+
+/**
+ * Resolution of the timers of an engine
+ *
+ * With milliseconds, deadlines are truncated to the millisecond and the
+ * event loop waits with a plain epoll_wait. With microseconds, deadlines
+ * are kept as is and the event loop waits with a precise timeout, which
+ * may cost an additional syscall on kernels without epoll_pwait2.
+ */
+enum class timer_resolution { milliseconds, microseconds };
+
+/**
+ * Clock used for boson::now() and timer deadlines
+ *
+ * The cached clock is read once per scheduler iteration, so it lags
+ * behind by the time spent running routines since then. Deadlines may
+ * thus be that much early. The precise clock is read at each call.
+ */
+enum class clock_mode { cached, precise };
+
+namespace internal {
+
+// Converts a duration to microseconds, rounding up so that timers never fire early
+template <class Rep, class Period>
+inline std::chrono::microseconds ceil_microseconds(std::chrono::duration<Rep, Period> duration) {
+  auto result = std::chrono::duration_cast<std::chrono::microseconds>(duration);
+  if (result < duration) ++result;
+  return result;
+}
+
+}  // namespace internal
+}  // namespace boson
+
+#endif  // BOSON_TIMERS_H_
@@ -2,74 +2,87 @@
 
 namespace boson {
 
-void engine::push_command(thread_id from, std::unique_ptr<command> new_command) {
+void engine::push_command(thread_id from, command* new_command) {
   command_pushers_.fetch_add(std::memory_order_release);
   // command_waiter_.notify_one();
   //command_queue_.write(static_cast<int>(from), new_command.release());
-  command_queue_.write(std::move(new_command));
+  command_queue_.write(new_command);
+  // Synchronize with the waiter so the notification cannot be lost between
+  // its predicate check and its wait
+  { std::lock_guard<std::mutex> guard(command_mutex_); }
   command_waiter_.notify_one();
 }
 
+auto engine::new_command(thread_id from, command_type type) -> command* {
+  command* result = command_pools_[from]->engine_commands.allocate();
+  result->from = from;
+  result->type = type;
+  return result;
+}
+
+auto engine::new_thread_command(thread_id from, internal::thread_command_type type) -> command_t* {
+  command_t* result = command_pools_[from]->thread_commands.allocate();
+  result->type = type;
+  return result;
+}
+
+void engine::start_routine(thread_id from, thread_id target_thread,
+                           std::unique_ptr<internal::routine> new_routine) {
+  nb_live_routines_.fetch_add(1, std::memory_order_relaxed);
+  if (target_thread == max_nb_cores_)
+    target_thread = placement_->place(thread_loads{*this});
+  else
+    new_routine->pin();
+  auto& target = threads_.at(target_thread)->thread;
+  if (target_thread == from) {
+    target.schedule_new_routine(std::move(new_routine));
+  } else {
+    command_t* add_command = new_thread_command(from, internal::thread_command_type::add_routine);
+    add_command->new_routine = new_routine.release();
+    target.push_command(from, add_command);
+  }
+}
+
 void engine::execute_commands() {
-  std::unique_ptr<command> new_command;
+  bool has_read = false;
   do {
-    //new_command.release();
-    new_command.reset(nullptr);
-    if (command_queue_.read(new_command)) {
+    command* new_command = command_queue_.read();
+    has_read = nullptr != new_command;
+    if (has_read) {
       switch (new_command->type) {
-        case command_type::add_routine: {
-          thread_id target_thread;
-          std::unique_ptr<internal::routine> new_routine;
-          tie(target_thread, new_routine) = move(new_command->data.raw<command_new_routine_data>());
-          if (target_thread == max_nb_cores_) {
-            target_thread = next_scheduled_thread_++;
-            next_scheduled_thread_ %= max_nb_cores_;
-          }
-          auto& view = *threads_.at(target_thread);
-          ++view.nb_routines;
-          view.thread.push_command(
-              max_nb_cores_, std::make_unique<command_t>(internal::thread_command_type::add_routine,
-                                                         move(new_routine)));
-        } break;
         case command_type::notify_idle: {
-          auto& view = *threads_.at(new_command->from);
-          view.nb_routines = new_command->data.get<size_t>();
+          // Only used to wake the engine up, see wait_all_routines
         } break;
         case command_type::notify_end_of_thread: {
           --nb_active_threads_;
         } break;
         case command_type::fd_panic: {
-          int fd = new_command->data.get<int>();
           for (auto& thread : threads_) {
-            thread->thread.push_command(
-                max_nb_cores_,
-                std::make_unique<command_t>(internal::thread_command_type::fd_panic, fd));
+            command_t* panic_command =
+                new_thread_command(max_nb_cores_, internal::thread_command_type::fd_panic);
+            panic_command->fd = new_command->fd;
+            thread->thread.push_command(max_nb_cores_, panic_command);
           }
         } break;
       }
+      memory::node_pool<command>::release(new_command);
       command_pushers_.fetch_sub(std::memory_order_release);
     }
 
-  } while (new_command || 0 < this->command_pushers_.load(std::memory_order_acquire));
+  } while (has_read || 0 < this->command_pushers_.load(std::memory_order_acquire));
 }
 
 void engine::wait_all_routines() {
-  std::mutex mut;
-  std::unique_lock<std::mutex> lock(mut);
+  std::unique_lock<std::mutex> lock(command_mutex_);
 
   while (0 < nb_active_threads_) {
     execute_commands();
-    size_t nb_remaining_routines = 0;
-    for (auto& view_ptr : threads_) {
-      nb_remaining_routines += view_ptr->nb_routines;
-    }
-    if (0 == nb_remaining_routines) {
+    if (0 == nb_live_routines_.load(std::memory_order_acquire)) {
       for (auto& thread : threads_) {
         if (!thread->sent_end_request) {
           thread->sent_end_request = true;
           thread->thread.push_command(
-              max_nb_cores_,
-              std::make_unique<command_t>(internal::thread_command_type::finish, nullptr));
+              max_nb_cores_, new_thread_command(max_nb_cores_, internal::thread_command_type::finish));
         }
       }
     }
@@ -82,20 +95,71 @@ void engine::wait_all_routines() {
 
 engine::engine(size_t max_nb_cores)
     : nb_active_threads_{max_nb_cores},
+      fd_generations_{new std::atomic<std::uint32_t>[nb_fd_generations]()},
+      file_workers_{*this},
       max_nb_cores_{max_nb_cores},
+      placement_{new round_robin_placement},
+#ifdef BOSON_USE_IO_URING
+      event_backend_{event_backend::io_uring},
+#else
+      event_backend_{event_backend::epoll},
+#endif
       //command_loop_(*this, static_cast<int>(max_nb_cores + 1)),
       command_queue_{},
       command_pushers_{0} {
-  // Start threads
+  // One pool per thread, plus the one of the engine owner
+  command_pools_.reserve(max_nb_cores_ + 1);
+  for (size_t index = 0; index <= max_nb_cores_; ++index) {
+    command_pools_.emplace_back(new command_pools);
+  }
+
+  // Create every thread before starting them, so they can steal from each other
   threads_.reserve(max_nb_cores);
   for (size_t index = 0; index < max_nb_cores_; ++index) {
     threads_.emplace_back(new thread_view_t(*this));
-    auto& created_thread = threads_.back();
-    threads_.back()->std_thread =
+  }
+
+  // Start threads
+  for (auto& created_thread : threads_) {
+    created_thread->std_thread =
         std::thread([&created_thread]() { created_thread->thread.loop(); });
   }
 };
 
+void engine::set_placement_policy(std::unique_ptr<placement_policy> policy) {
+  placement_ = std::move(policy);
+}
+
+void engine::set_timer_resolution(timer_resolution resolution) {
+  timer_resolution_.store(resolution, std::memory_order_relaxed);
+}
+
+void engine::set_clock_mode(clock_mode mode) {
+  clock_mode_.store(mode, std::memory_order_relaxed);
+}
+
+void engine::set_event_backend(event_backend backend) {
+  event_backend_.store(backend, std::memory_order_relaxed);
+}
+
+void engine::set_busy_poll(std::chrono::microseconds budget) {
+  busy_poll_us_.store(std::max<std::int64_t>(0, budget.count()), std::memory_order_relaxed);
+}
+
+void engine::set_max_file_workers(std::size_t max_nb_workers) {
+  max_file_workers_.store(std::max<std::size_t>(1, max_nb_workers), std::memory_order_relaxed);
+}
+
+void engine::set_stack_pool_config(stack_pool_config const& config) {
+  stack_pool_.set_config(config);
+}
+
+engine_statistics engine::statistics() const {
+  engine_statistics result;
+  for (auto& view : threads_) view->thread.add_statistics(result);
+  return result;
+}
+
 void engine::event(int event_id, void* data, event_status status) {
 }
 
@@ -105,6 +169,9 @@ void engine::read(int fd, void* data, event_status status) {
 void engine::write(int fd, void* data, event_status status) {
 }
 
+void engine::completion(void* data, event_status status) {
+}
+
 thread_id engine::register_thread_id() {
   auto new_id = current_thread_id_++;
   return new_id;
@@ -112,6 +179,8 @@ thread_id engine::register_thread_id() {
 
 engine::~engine() {
   wait_all_routines();
+  // Workers may still be waking a finished thread up
+  file_workers_.stop();
 
   // Join everyone
   for (auto& thread : threads_) {
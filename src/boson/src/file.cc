@@ -0,0 +1,69 @@
+#include "boson/file.h"
+#include <cerrno>
+#include "boson/internal/file_workers.h"
+#include "boson/internal/thread.h"
+#include "boson/syscalls.h"
+
+namespace boson {
+namespace file {
+
+using internal::file_operation;
+using internal::file_operation_type;
+
+namespace {
+inline ssize_t to_return_code(event_status status) {
+  if (status < 0) {
+    errno = -status;
+    return -1;
+  }
+  return status;
+}
+
+/**
+ * Runs the operation in the ring of the thread if it has one, else in a file worker
+ */
+inline ssize_t run(io_operation const& ring_operation, file_operation const& operation) {
+  // io_uring would take it as the file position
+  if (operation.offset < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (internal::current_thread()->uses_io_uring())
+    return to_return_code(submit_operation(ring_operation, -1));
+  return to_return_code(submit_file_operation(operation));
+}
+}  // namespace
+
+fd_t open(char const* path, int flags, mode_t mode) {
+  file_operation operation{file_operation_type::open, -1, nullptr, 0};
+  operation.path = path;
+  operation.flags = flags;
+  operation.mode = mode;
+  return static_cast<fd_t>(to_return_code(submit_file_operation(operation)));
+}
+
+ssize_t pread(fd_t fd, void* buffer, size_t count, off_t offset) {
+  return run(io_operation{io_operation_type::read, fd, buffer, count, nullptr, 0, offset},
+             file_operation{file_operation_type::pread, fd, buffer, count, offset});
+}
+
+ssize_t pwrite(fd_t fd, void const* buffer, size_t count, off_t offset) {
+  return run(io_operation{io_operation_type::write, fd, const_cast<void*>(buffer), count, nullptr,
+                          0, offset},
+             file_operation{file_operation_type::pwrite, fd, const_cast<void*>(buffer), count,
+                            offset});
+}
+
+int fsync(fd_t fd) {
+  return static_cast<int>(run(io_operation{io_operation_type::fsync, fd, nullptr, 0},
+                              file_operation{file_operation_type::fsync, fd, nullptr, 0}));
+}
+
+int stat(char const* path, struct stat* result) {
+  file_operation operation{file_operation_type::stat, -1, result, 0};
+  operation.path = path;
+  return static_cast<int>(to_return_code(submit_file_operation(operation)));
+}
+
+}  // namespace file
+}  // namespace boson
@@ -0,0 +1,106 @@
+#include "internal/file_workers.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include "engine.h"
+#include "internal/thread.h"
+
+namespace boson {
+namespace internal {
+
+namespace {
+event_status execute(file_operation const& operation) {
+  ssize_t result = -1;
+  switch (operation.type) {
+    case file_operation_type::open:
+      result = ::open(operation.path, operation.flags, operation.mode);
+      break;
+    case file_operation_type::pread:
+      result = ::pread(operation.fd, operation.buffer, operation.size, operation.offset);
+      break;
+    case file_operation_type::pwrite:
+      result = ::pwrite(operation.fd, operation.buffer, operation.size, operation.offset);
+      break;
+    case file_operation_type::fsync:
+      result = ::fsync(operation.fd);
+      break;
+    case file_operation_type::stat:
+      result = ::stat(operation.path, static_cast<struct stat*>(operation.buffer));
+      break;
+  }
+  return result < 0 ? -errno : static_cast<event_status>(result);
+}
+}  // namespace
+
+constexpr std::size_t file_workers::max_batch_size;
+
+file_workers::file_workers(engine& parent_engine) : engine_(parent_engine) {
+}
+
+file_workers::~file_workers() {
+  stop();
+}
+
+void file_workers::submit(file_operation const& operation, thread_id from,
+                          std::size_t slot_index) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  jobs_.push_back(job{operation, from, slot_index});
+  if (0 == nb_idle_workers_ && workers_.size() < engine_.get_max_file_workers()) {
+    command_pools_.emplace_back(new memory::node_pool<thread_command>);
+    workers_.emplace_back([this, index = workers_.size()]() { work(index); });
+  } else {
+    waiter_.notify_one();
+  }
+}
+
+void file_workers::stop() {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    stopping_ = true;
+  }
+  waiter_.notify_all();
+  for (auto& worker : workers_) worker.join();
+  workers_.clear();
+}
+
+void file_workers::work(std::size_t worker_index) {
+  std::vector<job> batch;
+  std::vector<thread_command*> commands(engine_.max_nb_cores(), nullptr);
+  std::unique_lock<std::mutex> lock(mutex_);
+  memory::node_pool<thread_command>& pool = *command_pools_[worker_index];
+  while (true) {
+    ++nb_idle_workers_;
+    waiter_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+    --nb_idle_workers_;
+    if (jobs_.empty()) return;
+
+    // Share the queue with the other workers, slow disks still run in parallel
+    std::size_t nb_taken = std::min(max_batch_size,
+                                    (jobs_.size() + workers_.size() - 1) / workers_.size());
+    batch.assign(jobs_.begin(), jobs_.begin() + nb_taken);
+    jobs_.erase(jobs_.begin(), jobs_.begin() + nb_taken);
+    lock.unlock();
+
+    for (auto& current : batch) {
+      thread_command*& command = commands[current.from];
+      if (!command) {
+        command = pool.allocate();
+        command->type = thread_command_type::complete_operations;
+      }
+      command->completions.emplace_back(current.slot_index, execute(current.operation));
+    }
+    for (thread_id id = 0; id < commands.size(); ++id) {
+      if (commands[id]) {
+        engine_.threads_[id]->thread.push_command(engine_.max_nb_cores(), commands[id]);
+        commands[id] = nullptr;
+      }
+    }
+
+    lock.lock();
+  }
+}
+
+}  // namespace internal
+}  // namespace boson
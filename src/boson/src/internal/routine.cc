@@ -17,28 +17,60 @@ void resume_routine(transfer_t transfered_context) {
   current_routine->status_ = routine_status::running;
   (*current_routine->func_)();
   current_routine->status_ = routine_status::finished;
-  jump_fcontext(this_thread->context().fctx, nullptr);
+  // The routine may have been stolen by another thread in the meantime
+  jump_fcontext(current_thread()->context().fctx, nullptr);
 }
 }
 
 // class routine;
 
 routine::~routine() {
-  deallocate(stack_);
+  if (dynamic_cast<void*>(func_) == &inline_function_)
+    func_->~function_holder();
+  else
+    delete func_;
+
+  // Routines which never ran have no stack
+  if (!stack_.sp) return;
+  thread* this_thread = current_thread();
+  if (this_thread)
+    this_thread->stack_cache_.release(stack_size_, stack_, *function_type_);
+  else
+    deallocate(stack_);
+}
+
+void* routine::operator new(std::size_t size, routine_pool& pool) {
+  assert(size <= sizeof(routine_block::storage));
+  return &pool.allocate()->storage;
+}
+
+void routine::operator delete(void* pointer, routine_pool& pool) {
+  routine::operator delete(pointer);
+}
+
+void routine::operator delete(void* pointer) {
+  routine_pool::release(reinterpret_cast<routine_block*>(static_cast<char*>(pointer) -
+                                                         offsetof(routine_block, storage)));
+}
+
+void routine::invalidate_slots() {
+  auto& generation = reinterpret_cast<routine_block*>(reinterpret_cast<char*>(this) -
+                                                      offsetof(routine_block, storage))
+                         ->generation;
+  // Only the thread running the round changes it, other ones may read it
+  generation.store(generation.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
 }
 
 void routine::start_event_round() {
   // Clean previous events
-  //previous_events_.clear();
-  //std::swap(previous_events_, events_);
   events_.clear();
-  // Create new event pointer
-  current_ptr_ = routine_local_ptr_t(std::unique_ptr<routine>(this));
+  // Round 0 is reserved for entries owned by the run queue
+  if (0 == ++event_round_) ++event_round_;
 }
 
 void routine::add_semaphore_wait(semaphore* sema) {
   events_.emplace_back(waited_event{event_type::sema_wait, routine_sema_event_data{sema,0,0}});
-  auto slot_index = thread_->register_semaphore_wait(routine_slot{current_ptr_,events_.size()-1});
+  auto slot_index = thread_->register_semaphore_wait(routine_slot{this, generation(), events_.size() - 1});
   events_.back().data.get<routine_sema_event_data>().index = sema->write(thread_, slot_index);
   events_.back().data.get<routine_sema_event_data>().slot_index = slot_index;
   int result = sema->counter_.fetch_add(1,std::memory_order_release);
@@ -48,22 +80,35 @@ void routine::add_semaphore_wait(semaphore* sema) {
 }
 
 void routine::add_timer(routine_time_point date) {
-  events_.emplace_back(waited_event{event_type::timer, routine_timer_event_data{std::move(date),nullptr}});
+  events_.emplace_back(waited_event{event_type::timer, routine_timer_event_data{std::move(date),0}});
   auto& event = events_.back();
-  event.data.get<routine_timer_event_data>().neighbor_timers =
-      &thread_->register_timer(event.data.get<routine_timer_event_data>().date, routine_slot{current_ptr_,events_.size()-1});
+  event.data.get<routine_timer_event_data>().timer =
+      thread_->register_timer(event.data.get<routine_timer_event_data>().date, routine_slot{this, generation(), events_.size() - 1});
 }
 
 void routine::add_read(int fd) {
   events_.emplace_back(waited_event{event_type::io_read, routine_io_event{fd, -1, fd_status::unknown, fd_status::unknown}});
   events_.back().data.get<routine_io_event>().event_id =
-      thread_->register_read(fd, routine_slot{current_ptr_, events_.size() - 1});
+      thread_->register_read(fd, routine_slot{this, generation(), events_.size() - 1});
 }
 
 void routine::add_write(int fd) {
   events_.emplace_back(waited_event{event_type::io_write, routine_io_event{fd, -1, fd_status::unknown, fd_status::unknown}});
   events_.back().data.get<routine_io_event>().event_id =
-      thread_->register_write(fd, routine_slot{current_ptr_, events_.size() - 1});
+      thread_->register_write(fd, routine_slot{this, generation(), events_.size() - 1});
+}
+
+void routine::add_operation(io_operation const& operation, int timeout_ms) {
+  assert(events_.empty());
+  events_.emplace_back(waited_event{event_type::io_operation, routine_io_event{operation.fd, -1, fd_status::unknown, fd_status::unknown}});
+  thread_->register_operation(operation, timeout_ms, routine_slot{this, generation(), events_.size() - 1});
+}
+
+void routine::add_file_operation(file_operation const& operation) {
+  assert(events_.empty());
+  // Completed like the io_uring operations
+  events_.emplace_back(waited_event{event_type::io_operation, routine_io_event{operation.fd, -1, fd_status::unknown, fd_status::unknown}});
+  thread_->register_file_operation(operation, routine_slot{this, generation(), events_.size() - 1});
 }
 
 size_t routine::commit_event_round() {
@@ -79,8 +124,7 @@ void routine::cancel_event_round() {
       case event_type::none:
         break;
       case event_type::timer: {
-        auto& data = other.data.get<routine_timer_event_data>();
-        --data.neighbor_timers->nb_active;
+        thread_->cancel_timer(other.data.get<routine_timer_event_data>().timer);
       } break;
       case event_type::io_read:
         --thread_->nb_suspended_routines_;
@@ -98,19 +142,20 @@ void routine::cancel_event_round() {
         }
       } break;
       case event_type::sema_closed:
+      case event_type::io_operation:  // Submitted operations always complete
         assert(false);
         break;
     }
   }
-  current_ptr_->release();
-  current_ptr_.invalidate_all();
+  invalidate_slots();
   events_.clear();
-  //std::swap(previous_events_, events_);
 }
 
 void routine::set_as_semaphore_event_candidate(std::size_t index) {
   status_ = routine_status::sema_event_candidate;
-  thread_->scheduled_routines_.emplace_back(routine_slot{current_ptr_,index});
+  ++nb_candidacies_;
+  thread_->scheduled_routines_.push_back(
+      scheduled_routine{this, static_cast<std::uint32_t>(index), event_round_});
 }
 
 bool routine::event_happened(std::size_t index, event_status status) {
@@ -125,6 +170,7 @@ bool routine::event_happened(std::size_t index, event_status status) {
       break;
     case event_type::io_read:
     case event_type::io_write:
+    case event_type::io_operation:
       happened_type_ = event.type;
       happened_rc_ = status;
       --thread_->nb_suspended_routines_;
@@ -143,7 +189,7 @@ bool routine::event_happened(std::size_t index, event_status status) {
         // do not change the routine status
         // do not invalidate event slot in the thread
         auto slot_index =
-            thread_->register_semaphore_wait(routine_slot{current_ptr_, index});
+            thread_->register_semaphore_wait(routine_slot{this, generation(), index});
         event.data.get<routine_sema_event_data>().index = sema->write(thread_, slot_index);
         result = sema->counter_.fetch_add(1, std::memory_order_release);
         if (0 <= result) {
@@ -167,8 +213,7 @@ bool routine::event_happened(std::size_t index, event_status status) {
         case event_type::none:
           break;
         case event_type::timer: {
-            auto& data = other.data.get<routine_timer_event_data>();
-            --data.neighbor_timers->nb_active;
+            thread_->cancel_timer(other.data.get<routine_timer_event_data>().timer);
           }
           break;
         case event_type::io_read:
@@ -187,6 +232,7 @@ bool routine::event_happened(std::size_t index, event_status status) {
           }
         } break;
         case event_type::sema_closed:
+        case event_type::io_operation:
           assert(false);
           break;
       }
@@ -195,17 +241,13 @@ bool routine::event_happened(std::size_t index, event_status status) {
 
   if (happened_type_ == event_type::sema_wait || happened_type_ == event_type::sema_closed) {
     status_ = routine_status::yielding;
-    current_ptr_->release();  // in this particular case, the scheduler gets back routine ownership
-    current_ptr_.invalidate_all();
+    invalidate_slots();  // in this particular case, the scheduler gets back routine ownership
     happened_index_ = index;
     return true;
   }
   else if (happened_type_ != event_type::none) {
-    //if (happened_type_ == event_type::timer)
-      //thread_->scheduled_routines_.emplace_front(routine_slot{routine_local_ptr_t(std::unique_ptr<routine>(current_ptr_->release())),0});
-    //else
-    thread_->scheduled_routines_.emplace_back(routine_slot{routine_local_ptr_t(std::unique_ptr<routine>(current_ptr_->release())),0});
-    current_ptr_.invalidate_all();
+    thread_->scheduled_routines_.push_back(scheduled_routine{this, 0, 0});
+    invalidate_slots();
     status_ = routine_status::yielding;
     happened_index_ = index;
     return true;
@@ -222,6 +264,7 @@ void routine::resume(thread* managing_thread) {
   thread_ = managing_thread;
   switch (status_) {
     case routine_status::is_new: {
+      stack_ = thread_->stack_cache_.allocate(stack_size_);
       context_.fctx = make_fcontext(stack_.sp, stack_.size, detail::resume_routine);
       context_ = jump_fcontext(context_.fctx, nullptr);
       break;
@@ -242,6 +285,8 @@ void routine::resume(thread* managing_thread) {
     (*func)(thread_);
     context_ = jump_fcontext(context_.fctx, nullptr);
   }
+  // Back to the scheduler, faults are not ours anymore
+  thread_->running_routine_ = nullptr;
 }
 
 std::size_t routine::get_stack_offset(void* pointer) {
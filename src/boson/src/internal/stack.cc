@@ -1,16 +1,113 @@
 #include "internal/stack.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "exception.h"
 
 namespace boson {
 namespace internal {
 
+namespace {
+// Linux 6.13, guard regions do not split the mapping
+constexpr int madvise_guard_install = 102;
+
+constexpr std::uint64_t canary = 0xb050b050b050b050ull;
+
+// Top of a new stack, where the first context switch loads registers from
+constexpr std::size_t context_size = 64;
+
+inline std::uint64_t* stack_bottom(stack_context const& sctx) {
+  return reinterpret_cast<std::uint64_t*>(static_cast<char*>(sctx.sp) - sctx.size);
+}
+}
+
+void protect(void* mapping, std::size_t mapped_size, std::size_t guard_size) {
+#if defined(__linux__)
+  if (0 == ::madvise(mapping, guard_size, madvise_guard_install)) return;
+#endif
+  if (0 != ::mprotect(mapping, guard_size, PROT_NONE)) {
+    int error = errno;
+    ::munmap(mapping, mapped_size);
+    throw exception(std::string("Syscall error (mprotect): ") + ::strerror(error));
+  }
+}
+
+bool uses_guard_pages(stack_protection protection) {
+  switch (protection) {
+    case stack_protection::guard_page:
+      return true;
+    case stack_protection::automatic: {
+      // Probed once, guard regions are free if the kernel supports them
+      static bool const has_guard_regions = []() {
+        std::size_t page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        void* page =
+            ::mmap(nullptr, page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (MAP_FAILED == page) return false;
+        bool supported = 0 == ::madvise(page, page_size, madvise_guard_install);
+        ::munmap(page, page_size);
+        return supported;
+      }();
+      return has_guard_regions;
+    }
+    case stack_protection::none:
+    default:
+      return false;
+  }
+}
+
+stack_context allocate(stack_size size, stack_protection protection) {
+  bool is_protected = uses_guard_pages(protection);
+  switch (size) {
+    case stack_size::small:
+      return allocate<small_stack_traits>(is_protected);
+    case stack_size::large:
+      return allocate<large_stack_traits>(is_protected);
+    case stack_size::huge:
+      return allocate<huge_stack_traits>(is_protected);
+    case stack_size::medium:
+    default:
+      return allocate<default_stack_traits>(is_protected);
+  }
+}
+
 void deallocate(stack_context& sctx) noexcept {
 #if defined(BOSON_USE_VALGRIND)
   VALGRIND_STACK_DEREGISTER(sctx.valgrind_stack_id);
 #endif
 
-  void* vp = static_cast<char*>(sctx.sp) - sctx.size;
+  void* vp = static_cast<char*>(sctx.sp) - sctx.size - sctx.guard_size;
   // conform to POSIX.4 (POSIX.1b-1993, _POSIX_C_SOURCE=199309L)
-  ::munmap(vp, sctx.size);
+  ::munmap(vp, sctx.guard_size + sctx.size);
+}
+
+void paint(stack_context const& sctx) noexcept {
+  std::uint64_t* bottom = stack_bottom(sctx);
+  std::uint64_t* top = bottom + sctx.size / sizeof(std::uint64_t);
+  std::uint64_t* context = top - context_size / sizeof(std::uint64_t);
+  std::fill(bottom, context, canary);
+  // Registers holding the canary would be saved as unused stack
+  std::fill(context, top, 0);
+}
+
+std::size_t measure_usage(stack_context const& sctx) noexcept {
+  std::uint64_t* bottom = stack_bottom(sctx);
+  std::uint64_t* top = bottom + sctx.size / sizeof(std::uint64_t);
+  // Stacks grow down, the deepest write is the first overwritten canary
+  std::uint64_t* deepest =
+      std::find_if(bottom, top, [](std::uint64_t word) { return canary != word; });
+  return (top - deepest) * sizeof(std::uint64_t);
+}
+
+void release_memory(stack_context& sctx) noexcept {
+  void* vp = static_cast<char*>(sctx.sp) - sctx.size;
+#if defined(MADV_FREE)
+  // Lazy, pages not reclaimed yet by the kernel are reused as is
+  ::madvise(vp, sctx.size, MADV_FREE);
+#else
+  ::madvise(vp, sctx.size, MADV_DONTNEED);
+#endif
 }
 }
 }
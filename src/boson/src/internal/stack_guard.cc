@@ -0,0 +1,122 @@
+#include "internal/stack_guard.h"
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include "internal/routine.h"
+#include "internal/thread.h"
+
+extern "C" {
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+}
+
+namespace boson {
+namespace internal {
+
+namespace {
+constexpr std::size_t alternate_stack_size = 64 * 1024;
+
+struct sigaction previous_action;
+std::mutex handler_mutex;
+
+/**
+ * Alternate signal stack of a thread, removed when the thread exits
+ */
+struct alternate_stack {
+  void* memory = nullptr;
+
+  ~alternate_stack() {
+    if (memory) {
+      stack_t disabled{};
+      disabled.ss_flags = SS_DISABLE;
+      ::sigaltstack(&disabled, nullptr);
+      ::munmap(memory, alternate_stack_size);
+    }
+  }
+};
+
+thread_local alternate_stack thread_alternate_stack;
+thread_local bool thread_watched = false;
+
+// Only async signal safe functions from here
+void write_error(char const* text) {
+  ::write(STDERR_FILENO, text, std::strlen(text));
+}
+
+void write_error(std::size_t value) {
+  char buffer[24];
+  char* first = buffer + sizeof(buffer);
+  do {
+    *--first = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (0 < value);
+  ::write(STDERR_FILENO, first, buffer + sizeof(buffer) - first);
+}
+
+void on_segmentation_fault(int signal_number, siginfo_t* info, void* context) {
+  thread* this_thread = current_thread();
+  routine* faulty_routine = this_thread ? this_thread->running_routine() : nullptr;
+  if (faulty_routine) {
+    stack_context const& stack = faulty_routine->stack();
+    char* fault = static_cast<char*>(info->si_addr);
+    char* guard_end = static_cast<char*>(stack.sp) - stack.size;
+    if (0 < stack.guard_size && guard_end - stack.guard_size <= fault && fault < guard_end) {
+      write_error("boson: stack overflow in routine ");
+      write_error(faulty_routine->id());
+      write_error(", stack of ");
+      write_error(stack.size);
+      write_error(" bytes\n");
+      std::abort();
+    }
+  }
+
+  // Not a routine overflow
+  if (previous_action.sa_flags & SA_SIGINFO) {
+    previous_action.sa_sigaction(signal_number, info, context);
+  } else if (SIG_DFL != previous_action.sa_handler && SIG_IGN != previous_action.sa_handler) {
+    previous_action.sa_handler(signal_number);
+  } else {
+    // The fault happens again on return, with the default action
+    ::signal(SIGSEGV, SIG_DFL);
+  }
+}
+
+void install_handler() {
+  std::lock_guard<std::mutex> guard(handler_mutex);
+  struct sigaction current;
+  ::sigaction(SIGSEGV, nullptr, &current);
+  if ((current.sa_flags & SA_SIGINFO) && on_segmentation_fault == current.sa_sigaction) return;
+  struct sigaction action;
+  std::memset(&action, 0, sizeof(action));
+  action.sa_sigaction = on_segmentation_fault;
+  action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+  ::sigemptyset(&action.sa_mask);
+  ::sigaction(SIGSEGV, &action, &previous_action);
+}
+}
+
+void watch_stack_overflows() {
+  if (thread_watched) return;
+  thread_watched = true;
+  // Checked for each thread, in case some other code replaced the handler
+  install_handler();
+
+  // Keep an alternate stack the user may have set up
+  stack_t current{};
+  ::sigaltstack(nullptr, &current);
+  if (!(current.ss_flags & SS_DISABLE)) return;
+  void* memory = ::mmap(nullptr, alternate_stack_size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (MAP_FAILED == memory) return;
+  stack_t alternate{};
+  alternate.ss_sp = memory;
+  alternate.ss_size = alternate_stack_size;
+  if (0 == ::sigaltstack(&alternate, nullptr))
+    thread_alternate_stack.memory = memory;
+  else
+    ::munmap(memory, alternate_stack_size);
+}
+
+}  // namespace internal
+}  // namespace boson
@@ -0,0 +1,129 @@
+#include "internal/stack_pool.h"
+#include <cxxabi.h>
+#include <algorithm>
+#include <cstdlib>
+#include "internal/stack_guard.h"
+
+namespace boson {
+namespace internal {
+
+namespace {
+inline std::size_t index_of(stack_size size) {
+  return static_cast<std::size_t>(size);
+}
+
+std::string demangle(std::type_info const& type) {
+  int status = 0;
+  char* name = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+  if (!name) return type.name();
+  std::string result{name};
+  std::free(name);
+  return result;
+}
+}
+
+stack_pool::~stack_pool() {
+  for (auto& stacks : stacks_) {
+    for (auto& stack : stacks) deallocate(stack);
+  }
+}
+
+void stack_pool::take(stack_size size, std::vector<stack_context>& destination,
+                      std::size_t count) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto& stacks = stacks_[index_of(size)];
+  count = std::min(count, stacks.size());
+  destination.insert(end(destination), end(stacks) - count, end(stacks));
+  stacks.resize(stacks.size() - count);
+}
+
+void stack_pool::give(stack_size size, std::vector<stack_context>& source, std::size_t count) {
+  std::size_t nb_kept = 0;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto& stacks = stacks_[index_of(size)];
+    if (stacks.size() < config_.global_capacity)
+      nb_kept = std::min(count, config_.global_capacity - stacks.size());
+    stacks.insert(end(stacks), begin(source), begin(source) + nb_kept);
+  }
+  // Over capacity
+  for (std::size_t index = nb_kept; index < count; ++index) deallocate(source[index]);
+  source.erase(begin(source), begin(source) + count);
+}
+
+stack_cache::stack_cache(stack_pool& global) : global_{global} {
+}
+
+stack_cache::~stack_cache() {
+  for (std::size_t index = 0; index < nb_stack_sizes; ++index)
+    global_.give(static_cast<stack_size>(index), stacks_[index], stacks_[index].size());
+}
+
+stack_context stack_cache::allocate(stack_size size) {
+  auto const& config = global_.config();
+  if (uses_guard_pages(config.protection)) watch_stack_overflows();
+  auto& stacks = stacks_[index_of(size)];
+  if (stacks.empty())
+    global_.take(size, stacks, std::max<std::size_t>(1, config.thread_low_watermark));
+  stack_context stack;
+  if (stacks.empty()) {
+    nb_mapped_.store(nb_mapped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    stack = internal::allocate(size, config.protection);
+  } else {
+    nb_reused_.store(nb_reused_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    stack = stacks.back();
+    stacks.pop_back();
+  }
+  if (config.measure_usage) paint(stack);
+  return stack;
+}
+
+void stack_cache::record_usage(stack_context const& stack, std::type_info const& function) {
+  std::size_t usage = measure_usage(stack);
+  std::size_t bucket = 0;
+  while (bucket + 1 < nb_stack_usage_buckets && (std::size_t{1024} << bucket) < usage) ++bucket;
+  std::lock_guard<std::mutex> guard(usages_mutex_);
+  auto inserted = usages_.emplace(function, stack_usage{});
+  stack_usage& record = inserted.first->second;
+  if (inserted.second) record.function = demangle(function);
+  ++record.nb_routines;
+  record.max_bytes = std::max(record.max_bytes, usage);
+  ++record.histogram[bucket];
+}
+
+void stack_cache::release(stack_size size, stack_context const& stack,
+                          std::type_info const& function) {
+  if (global_.config().measure_usage) record_usage(stack, function);
+  auto& stacks = stacks_[index_of(size)];
+  stacks.push_back(stack);
+  auto const& config = global_.config();
+  if (config.thread_high_watermark < stacks.size()) {
+    // The oldest stacks are the less likely to be resident
+    std::size_t nb_given = stacks.size() - std::min(config.thread_low_watermark, stacks.size());
+    for (std::size_t index = 0; index < nb_given; ++index) release_memory(stacks[index]);
+    global_.give(size, stacks, nb_given);
+  }
+}
+
+void stack_cache::add_statistics(engine_statistics& statistics) const {
+  statistics.nb_stacks_mapped += nb_mapped_.load(std::memory_order_relaxed);
+  statistics.nb_stacks_reused += nb_reused_.load(std::memory_order_relaxed);
+  std::lock_guard<std::mutex> guard(usages_mutex_);
+  for (auto const& entry : usages_) {
+    stack_usage const& record = entry.second;
+    auto found = std::find_if(
+        begin(statistics.stack_usages), end(statistics.stack_usages),
+        [&record](stack_usage const& other) { return record.function == other.function; });
+    if (found == end(statistics.stack_usages)) {
+      statistics.stack_usages.push_back(record);
+      continue;
+    }
+    found->nb_routines += record.nb_routines;
+    found->max_bytes = std::max(found->max_bytes, record.max_bytes);
+    for (std::size_t bucket = 0; bucket < nb_stack_usage_buckets; ++bucket)
+      found->histogram[bucket] += record.histogram[bucket];
+  }
+}
+
+}  // namespace internal
+}  // namespace boson
@@ -1,6 +1,8 @@
 #include "internal/thread.h"
+#include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <limits>
 #include "engine.h"
 #include "exception.h"
 #include "internal/routine.h"
@@ -10,6 +12,16 @@
 namespace boson {
 namespace internal {
 
+namespace {
+inline timing_wheel::tick_t to_tick(routine_time_point const& date) {
+  return date.time_since_epoch().count();
+}
+
+inline timing_wheel::tick_t to_tick(std::chrono::high_resolution_clock::time_point date) {
+  return to_tick(std::chrono::time_point_cast<std::chrono::microseconds>(date));
+}
+}
+
 // class engine_proxy;
 
 engine_proxy::engine_proxy(engine& parent_engine) : engine_(&parent_engine) {
@@ -21,20 +33,47 @@ engine_proxy::~engine_proxy() {
 
 void engine_proxy::notify_end() {
   engine_->push_command(current_thread_id_,
-                        std::make_unique<engine::command>(
-                            current_thread_id_, engine::command_type::notify_end_of_thread,
-                            engine::command_data{nullptr}));
+                        engine_->new_command(current_thread_id_,
+                                             engine::command_type::notify_end_of_thread));
 }
 
 routine_id engine_proxy::get_new_routine_id() {
   return engine_->current_routine_id_++;
 }
 
-void engine_proxy::notify_idle(size_t nb_suspended_routines) {
-  engine_->push_command(
-      current_thread_id_,
-      std::make_unique<engine::command>(current_thread_id_, engine::command_type::notify_idle,
-                                        engine::command_data{nb_suspended_routines}));
+void engine_proxy::notify_idle() {
+  engine_->push_command(current_thread_id_,
+                        engine_->new_command(current_thread_id_, engine::command_type::notify_idle));
+}
+
+void engine_proxy::notify_routine_end() {
+  // The last routine wakes the engine up so it can stop the threads
+  if (1 == engine_->nb_live_routines_.fetch_sub(1, std::memory_order_acq_rel))
+    notify_idle();
+}
+
+void engine_proxy::notify_idle_state(bool idle) {
+  if (idle)
+    engine_->nb_idle_threads_.fetch_add(1, std::memory_order_release);
+  else
+    engine_->nb_idle_threads_.fetch_sub(1, std::memory_order_release);
+}
+
+void engine_proxy::wake_up_idle_thread() {
+  for (auto& view : engine_->threads_) {
+    if (view->thread.claim_idle()) {
+      view->thread.wake_up();
+      return;
+    }
+  }
+}
+
+std::size_t engine_proxy::nb_idle_threads() const {
+  return engine_->nb_idle_threads_.load(std::memory_order_acquire);
+}
+
+thread& engine_proxy::get_thread(thread_id id) {
+  return engine_->threads_[id]->thread;
 }
 
 void engine_proxy::start_routine(std::unique_ptr<routine> new_routine) {
@@ -42,16 +81,40 @@ void engine_proxy::start_routine(std::unique_ptr<routine> new_routine) {
 }
 
 void engine_proxy::start_routine(thread_id target_thread, std::unique_ptr<routine> new_routine) {
-  engine_->push_command(current_thread_id_, std::make_unique<engine::command>(
-                                                target_thread, engine::command_type::add_routine,
-                                                engine::command_new_routine_data{
-                                                    target_thread, std::move(new_routine)}));
+  engine_->start_routine(current_thread_id_, target_thread, std::move(new_routine));
 }
 
 void engine_proxy::fd_panic(int fd) {
-  engine_->push_command(
-      current_thread_id_,
-      std::make_unique<engine::command>(current_thread_id_, engine::command_type::fd_panic, fd));
+  auto panic_command = engine_->new_command(current_thread_id_, engine::command_type::fd_panic);
+  panic_command->fd = fd;
+  engine_->push_command(current_thread_id_, panic_command);
+}
+
+thread_command* engine_proxy::new_command(thread_command_type type) {
+  return engine_->new_thread_command(current_thread_id_, type);
+}
+
+stack_pool& engine_proxy::get_stack_pool() {
+  return engine_->stack_pool_;
+}
+
+routine_pool& engine_proxy::get_routine_pool() {
+  return engine_->command_pools_[current_thread_id_]->routines;
+}
+
+std::uint32_t engine_proxy::get_fd_generation(int fd) const {
+  return engine_->fd_generations_[static_cast<std::size_t>(fd) % engine::nb_fd_generations].load(
+      std::memory_order_acquire);
+}
+
+void engine_proxy::notify_fd_closed(int fd) {
+  engine_->fd_generations_[static_cast<std::size_t>(fd) % engine::nb_fd_generations].fetch_add(
+      1, std::memory_order_release);
+}
+
+void engine_proxy::submit_file_operation(file_operation const& operation,
+                                         std::size_t slot_index) {
+  engine_->file_workers_.submit(operation, current_thread_id_, slot_index);
 }
 
 void engine_proxy::set_id() {
@@ -59,55 +122,71 @@ void engine_proxy::set_id() {
 }
 
 void thread::handle_engine_event() {
-  //thread_command* received_command = nullptr;
-  //while ((received_command = static_cast<thread_command*>(engine_queue_.read(id())))) {
-  std::unique_ptr<thread_command> received_command;
-  while (engine_queue_.read(received_command)) {
+  thread_command* received_command = nullptr;
+  while ((received_command = engine_queue_.read())) {
     nb_pending_commands_.fetch_sub(1);
     switch (received_command->type) {
-      case thread_command_type::add_routine:
-        scheduled_routines_.emplace_back(
-                routine_slot{std::move(received_command->data.get<routine_ptr_t>()), 0});
-        break;
+      case thread_command_type::add_routine: {
+        schedule_new_routine(routine_ptr_t(received_command->new_routine));
+        received_command->new_routine = nullptr;
+      } break;
       case thread_command_type::schedule_waiting_routine: {
-        auto& data = received_command->data.get<std::pair<std::weak_ptr<semaphore>, std::size_t>>();
-        auto& shared_routine = suspended_slots_[data.second];
+        auto& shared_routine = suspended_slots_[received_command->slot_index];
         // If not previously invalidated by a timeout
-        if (shared_routine.ptr) {
-          shared_routine.ptr->get()->set_as_semaphore_event_candidate(shared_routine.event_index);
+        if (routine* waiting_routine = shared_routine.get()) {
+          waiting_routine->set_as_semaphore_event_candidate(shared_routine.event_index);
         }
         else {
-          auto sema_pointer = data.first.lock();
+          auto sema_pointer = received_command->waiting_semaphore.lock();
           if (sema_pointer)
             sema_pointer->pop_a_waiter(this);
         }
-        suspended_slots_.free(data.second);
+        suspended_slots_.free(received_command->slot_index);
+        received_command->waiting_semaphore.reset();
       } break;
       case thread_command_type::finish:
         status_ = thread_status::finishing;
         break;
       case thread_command_type::fd_panic:
-        auto& fd = received_command->data.get<int>();
-        loop_->send_fd_panic(id(),fd);
+        loop_->send_fd_panic(id(), received_command->fd);
+        break;
+      case thread_command_type::complete_operations:
+        for (auto const& completed : received_command->completions)
+          completion(reinterpret_cast<void*>(completed.first), completed.second);
+        nb_file_operations_.fetch_add(received_command->completions.size(),
+                                      std::memory_order_relaxed);
+        nb_file_batches_.fetch_add(1, std::memory_order_relaxed);
+        received_command->completions.clear();
         break;
     }
-    //delete received_command;
-    //received_command.reset(nullptr);
+    memory::node_pool<thread_command>::release(received_command);
   }
 }
 
 void thread::unregister_all_events() {
-  loop_->unregister(engine_event_id_);
-  //loop_->unregister(self_event_id_);
+  loop_->unregister_event(engine_event_id_);
 }
 
-timed_routines_set& thread::register_timer(routine_time_point const& date, routine_slot slot) {
+timing_wheel::handle_t thread::register_timer(routine_time_point const& date, routine_slot slot) {
   auto index = suspended_slots_.allocate();
   suspended_slots_[index] = slot;
-  auto& current_set = timed_routines_[date];
-  current_set.slots.emplace_back(index);
-  ++current_set.nb_active;
-  return current_set;
+  auto deadline = to_tick(date);
+  if (timer_resolution::milliseconds == timer_resolution_)
+    deadline -= deadline % 1000;
+  return timers_.insert(deadline, index);
+}
+
+void thread::cancel_timer(timing_wheel::handle_t timer) {
+  suspended_slots_.free(timers_.value(timer));
+  timers_.cancel(timer);
+}
+
+void thread::fire_timers() {
+  timers_.advance(to_tick(now_), [this](std::size_t index) {
+    auto& slot = suspended_slots_[index];
+    if (routine* waiting_routine = slot.get()) waiting_routine->event_happened(slot.event_index);
+    suspended_slots_.free(index);
+  });
 }
 
 std::size_t thread::register_semaphore_wait(routine_slot slot) {
@@ -118,6 +197,8 @@ std::size_t thread::register_semaphore_wait(routine_slot slot) {
 }
 
 int thread::register_read(int fd, routine_slot slot) {
+  // The routine waits because the fd would block, older edges are outdated
+  consume_readiness(fd, true);
   int existing_read = -1;
   tie(existing_read, std::ignore) = loop_->get_events(fd);
   if (0 <= existing_read) {
@@ -134,6 +215,8 @@ int thread::register_read(int fd, routine_slot slot) {
 }
 
 int thread::register_write(int fd, routine_slot slot) {
+  // The routine waits because the fd would block, older edges are outdated
+  consume_readiness(fd, false);
   int existing_write = -1;
   tie(std::ignore, existing_write) = loop_->get_events(fd);
   if (0 <= existing_write) {
@@ -149,10 +232,113 @@ int thread::register_write(int fd, routine_slot slot) {
   return existing_write;
 }
 
+void thread::register_operation(io_operation const& operation, int timeout_ms,
+                                routine_slot slot) {
+  auto index = suspended_slots_.allocate();
+  suspended_slots_[index] = slot;
+  loop_->submit(operation, reinterpret_cast<void*>(index), timeout_ms);
+  ++nb_suspended_routines_;
+}
+
+void thread::register_file_operation(file_operation const& operation, routine_slot slot) {
+  auto index = suspended_slots_.allocate();
+  suspended_slots_[index] = slot;
+  engine_proxy_.submit_file_operation(operation, index);
+  ++nb_suspended_routines_;
+}
+
 void thread::unregister_expired_slot(std::size_t slot_index) {
   suspended_slots_.free(slot_index);
 }
 
+void thread::schedule_new_routine(routine_ptr_t new_routine) {
+  if (new_routine->is_pinned())
+    scheduled_routines_.push_back(scheduled_routine{new_routine.release(), 0, 0});
+  else
+    stealable_routines_.push(new_routine.release());
+}
+
+void thread::share_routine(routine* shared_routine) {
+  // Stale event slots of this thread do not match its generation anymore
+  stealable_routines_.push(shared_routine);
+}
+
+std::size_t thread::steal_routines() {
+  static constexpr std::size_t max_nb_stolen = 32;
+  std::size_t nb_threads = get_engine().max_nb_cores();
+  for (std::size_t offset = 1; offset < nb_threads; ++offset) {
+    thread& victim = engine_proxy_.get_thread((id() + offset) % nb_threads);
+    std::size_t nb_to_steal = std::min((victim.stealable_routines_.size() + 1) / 2, max_nb_stolen);
+    std::size_t nb_stolen = 0;
+    routine* stolen = nullptr;
+    while (nb_stolen < nb_to_steal && victim.stealable_routines_.steal(stolen)) {
+      stealable_routines_.push(stolen);
+      ++nb_stolen;
+    }
+    if (0 < nb_stolen)
+      return nb_stolen;
+  }
+  return 0;
+}
+
+void thread::routine_finished() {
+  engine_proxy_.notify_routine_end();
+}
+
+void thread::set_idle(bool idle) {
+  if (idle) {
+    if (!idle_.exchange(true, std::memory_order_acq_rel))
+      engine_proxy_.notify_idle_state(true);
+  } else {
+    claim_idle();
+  }
+}
+
+bool thread::claim_idle() {
+  bool expected = true;
+  if (idle_.load(std::memory_order_relaxed) &&
+      idle_.compare_exchange_strong(expected, false, std::memory_order_acq_rel)) {
+    engine_proxy_.notify_idle_state(false);
+    return true;
+  }
+  return false;
+}
+
+void thread::publish_load() {
+  published_nb_scheduled_.store(scheduled_routines_.size(), std::memory_order_relaxed);
+  published_nb_suspended_.store(nb_suspended_routines_, std::memory_order_relaxed);
+  published_nb_timers_.store(timers_.size(), std::memory_order_relaxed);
+}
+
+thread_load thread::load() const {
+  return {published_nb_scheduled_.load(std::memory_order_relaxed) + stealable_routines_.size(),
+          published_nb_suspended_.load(std::memory_order_relaxed),
+          published_nb_timers_.load(std::memory_order_relaxed),
+          nb_pending_commands_.load(std::memory_order_relaxed)};
+}
+
+void thread::add_statistics(engine_statistics& statistics) const {
+  statistics.nb_wakeups_sent += nb_wakeups_sent_.load(std::memory_order_relaxed);
+  statistics.nb_wakeups_saved += nb_wakeups_saved_.load(std::memory_order_relaxed);
+  stack_cache_.add_statistics(statistics);
+  statistics.nb_fd_registrations += loop_->nb_fd_registrations();
+  statistics.nb_io_operations += loop_->nb_io_operations();
+  statistics.nb_busy_poll_hits += nb_busy_poll_hits_.load(std::memory_order_relaxed);
+  statistics.nb_busy_poll_misses += nb_busy_poll_misses_.load(std::memory_order_relaxed);
+  statistics.nb_file_operations += nb_file_operations_.load(std::memory_order_relaxed);
+  statistics.nb_file_batches += nb_file_batches_.load(std::memory_order_relaxed);
+}
+
+bool thread::consume_readiness(int fd, bool is_read) {
+  loop_->watch(fd, engine_proxy_.get_fd_generation(fd));
+  return loop_->consume_readiness(fd, is_read);
+}
+
+void thread::watch_error_queue(int fd) {
+  loop_->watch(fd, engine_proxy_.get_fd_generation(fd));
+  loop_->watch_error_queue(fd);
+}
+
 void thread::unregister_fd(int fd) {
   //loop_->send_fd_panic(engine_proxy_.get_id(), fd);
   int existing_read, existing_write;
@@ -161,18 +347,31 @@ void thread::unregister_fd(int fd) {
     read(fd, loop_->get_data(existing_read), -EINTR);
   if (0 <= existing_write)
     write(fd, loop_->get_data(existing_write), -EINTR);
+  loop_->interrupt_operations(fd);
 }
 
 thread::thread(engine& parent_engine)
     : engine_proxy_(parent_engine),
+      stack_cache_(engine_proxy_.get_stack_pool()),
       loop_(new event_loop{*this, static_cast<int>(parent_engine.max_nb_cores() + 1)}),
-      engine_queue_{}
+      engine_queue_{},
+      now_{std::chrono::high_resolution_clock::now()},
+      timers_{to_tick(now_)}
 {
   engine_event_id_ = loop_->register_event(&engine_event_id_);
   engine_proxy_.set_id();  // Tells the engine which thread id we got
 }
 
-thread::~thread() {}
+thread::~thread() {
+  // Commands left behind still own their routines
+  thread_command* received_command = nullptr;
+  while ((received_command = engine_queue_.read())) {
+    delete received_command->new_routine;
+    received_command->new_routine = nullptr;
+    received_command->waiting_semaphore.reset();
+    memory::node_pool<thread_command>::release(received_command);
+  }
+}
 
 void thread::event(int event_id, void* data, event_status status) {
   if (event_id == engine_event_id_) {
@@ -182,10 +381,10 @@ void thread::event(int event_id, void* data, event_status status) {
 
 void thread::read(int fd, void* data, event_status status) {
   auto& slot = suspended_slots_[reinterpret_cast<std::size_t>(data)];
-  bool pointer_is_valid = slot.ptr;
-  bool unregister = !pointer_is_valid || status < 0;
-  if (pointer_is_valid) {
-    slot.ptr->get()->event_happened(slot.event_index, status);
+  routine* waiting_routine = slot.get();
+  bool unregister = !waiting_routine || status < 0;
+  if (waiting_routine) {
+    waiting_routine->event_happened(slot.event_index, status);
     if (status < 0)
       suspended_slots_.free(reinterpret_cast<std::size_t>(data));
   }
@@ -200,10 +399,10 @@ void thread::read(int fd, void* data, event_status status) {
 
 void thread::write(int fd, void* data, event_status status) {
   auto& slot = suspended_slots_[reinterpret_cast<std::size_t>(data)];
-  bool pointer_is_valid = slot.ptr;
-  bool unregister = !pointer_is_valid || status < 0;
-  if (pointer_is_valid) {
-    slot.ptr->get()->event_happened(slot.event_index, status);
+  routine* waiting_routine = slot.get();
+  bool unregister = !waiting_routine || status < 0;
+  if (waiting_routine) {
+    waiting_routine->event_happened(slot.event_index, status);
     if (status < 0)
       suspended_slots_.free(reinterpret_cast<std::size_t>(data));
   }
@@ -217,83 +416,128 @@ void thread::write(int fd, void* data, event_status status) {
   }
 }
 
+void thread::completion(void* data, event_status status) {
+  auto& slot = suspended_slots_[reinterpret_cast<std::size_t>(data)];
+  // Operations are alone in their event round, nothing else can end it
+  if (routine* waiting_routine = slot.get())
+    waiting_routine->event_happened(slot.event_index, status);
+  suspended_slots_.free(reinterpret_cast<std::size_t>(data));
+}
+
 // called by engine
-void thread::push_command(thread_id from, std::unique_ptr<thread_command> command) {
+void thread::push_command(thread_id from, thread_command* command) {
   nb_pending_commands_.fetch_add(1);
-  //engine_queue_.write(from, command.release());
-  engine_queue_.write(std::move(command));
-  loop_->send_event(engine_event_id_);
+  engine_queue_.write(command);
+  // An awake thread drains its inbox before waiting again
+  if (sleeping_.exchange(false)) {
+    nb_wakeups_sent_.fetch_add(1, std::memory_order_relaxed);
+    loop_->send_event(engine_event_id_);
+  } else {
+    nb_wakeups_saved_.fetch_add(1, std::memory_order_relaxed);
+  }
 };
 
+void thread::wake_up() {
+  loop_->send_event(engine_event_id_);
+}
+
 bool thread::execute_scheduled_routines() {
-  decltype(scheduled_routines_) next_scheduled_routines;
-  std::deque<std::tuple<size_t, routine_ptr_t>> new_timed_routines_;
+  set_idle(false);
   while (!scheduled_routines_.empty()) {
     // For now; we schedule them in order
-    auto& slot = scheduled_routines_.front();
-    if (slot.ptr) {
-      auto routine = running_routine_ = slot.ptr->get();
-
-      bool run_routine = true;
-      // Try to get a semaphore ticket, if relevant
-      if (routine->status() == routine_status::sema_event_candidate) {
-        run_routine = routine->event_happened(slot.event_index);
-        // If success, get back the unique ownership of the routine
-        if (run_routine) {
-          slot.ptr = routine_local_ptr_t(routine_ptr_t(routine));
-        }
+    scheduled_routine entry = scheduled_routines_.front();
+    scheduled_routines_.pop_front();
+    auto routine = entry.routine_ptr;
+
+    // Try to get a semaphore ticket, if relevant
+    if (0 != entry.event_round) {
+      --routine->nb_candidacies_;
+      bool outdated = entry.event_round != routine->event_round_ ||
+                      (routine->status() != routine_status::sema_event_candidate &&
+                       routine->status() != routine_status::wait_events);
+      if (outdated) {
+        // A finished routine waits for its last candidacy to be deleted
+        if (routine->status() == routine_status::finished && 0 == routine->nb_candidacies_)
+          delete routine;
+        continue;
+      }
+      running_routine_ = routine;
+      // If success, the run queue gets back the ownership of the routine
+      if (!routine->event_happened(entry.event_index)) {
+        // Thats means no event happened for the routine, its events stay valid
+        routine->status_ = routine_status::wait_events;
+        continue;
       }
-
-      if (run_routine) routine->resume(this);
-      switch (routine->status()) {
-        case routine_status::is_new:
-        case routine_status::running: {
-          // Not supposed to happen
-          assert(false);
-        } break;
-        case routine_status::yielding: {
-          // If not finished, then we reschedule it
-          next_scheduled_routines.emplace_back(
-              routine_slot{routine_local_ptr_t(routine_ptr_t(slot.ptr->release())), 0});
-        } break;
-        case routine_status::wait_events: {
-          slot.ptr->release();
-        } break;
-        case routine_status::sema_event_candidate: {
-          // Thats means no event happened for the routine, so we must let the slot pointer
-          // untouched for other events to stay valid
-          routine->status_ = routine_status::wait_events;
-        } break;
-        case routine_status::finished: {
-          // Should have been made by the routine by closing the FD
-        } break;
-      };
-
-      // if (routine.get()) {
-      // debug::log("Routine {}:{}:{} will be deleted.", id(), routine->id(),
-      // static_cast<int>(routine->status()));
-      //}
     }
-    scheduled_routines_.pop_front();
+
+    running_routine_ = routine;
+    routine->resume(this);
+    switch (routine->status()) {
+      case routine_status::yielding: {
+        // If not finished, then we reschedule it. Queued candidacies keep it here.
+        if (routine->is_pinned() || 0 < routine->nb_candidacies_)
+          next_scheduled_routines_.push_back(scheduled_routine{routine, 0, 0});
+        else
+          share_routine(routine);
+      } break;
+      case routine_status::wait_events: {
+        // Ownership now belongs to the event round
+      } break;
+      case routine_status::finished: {
+        // Should have been made by the routine by closing the FD
+        routine_finished();
+        if (0 == routine->nb_candidacies_)
+          delete routine;
+      } break;
+      default: {
+        // Not supposed to happen
+        assert(false);
+      } break;
+    };
   }
 
   // Yielded routines are immediately scheduled
-  scheduled_routines_ = std::move(next_scheduled_routines);
-
-  // Cleanup canceled timers
-  auto first_timed_routines = begin(timed_routines_);
-  while (first_timed_routines != end(timed_routines_) && first_timed_routines->second.nb_active == 0) {
-    // Clean up suspended vector
-    for (auto index : first_timed_routines->second.slots)
-      suspended_slots_.free(index);
-    // Delete full record
-    first_timed_routines = timed_routines_.erase(first_timed_routines);
+  scheduled_routines_.swap(next_scheduled_routines_);
+
+  // Execute the routines from the stealable run queue, yielded ones will
+  // be executed at the next round
+  std::size_t nb_stealable = stealable_routines_.size();
+  routine* shared_routine = nullptr;
+  while (0 < nb_stealable-- && stealable_routines_.steal(shared_routine)) {
+    running_routine_ = shared_routine;
+    shared_routine->resume(this);
+    switch (shared_routine->status()) {
+      case routine_status::yielding: {
+        share_routine(shared_routine);
+      } break;
+      case routine_status::wait_events: {
+        // Ownership now belongs to the event round
+      } break;
+      case routine_status::finished: {
+        assert(0 == shared_routine->nb_candidacies_);
+        delete shared_routine;
+        routine_finished();
+      } break;
+      default: {
+        // Not supposed to happen
+        assert(false);
+      } break;
+    }
   }
 
-  // If finished and no more routines, exit
+  publish_load();
+
+  // Nothing to run, try to get some work from other threads
   size_t nb_pending_commands = nb_pending_commands_;
+  bool has_runnable_routines = !scheduled_routines_.empty() || !stealable_routines_.empty();
+  if (!has_runnable_routines && 0 == nb_pending_commands &&
+      thread_status::finishing != status_) {
+    has_runnable_routines = 0 < steal_routines();
+  }
+
+  // If finished and no more routines, exit
   bool no_more_routines =
-      scheduled_routines_.empty() && timed_routines_.empty() && 0 == nb_suspended_routines_;
+      !has_runnable_routines && timers_.empty() && 0 == nb_suspended_routines_;
   if (no_more_routines) {
     if (0 == nb_pending_commands) {
         if (thread_status::finishing == status_) {
@@ -302,24 +546,23 @@ bool thread::execute_scheduled_routines() {
           return false;
         }
         else {
-          engine_proxy_.notify_idle(0);
+          set_idle(true);
           return false;
         }
     }
   } else {
-    if (scheduled_routines_.empty()) {
-      size_t nb_routines = timed_routines_.size() + nb_suspended_routines_;
+    if (!has_runnable_routines) {
       if (0 == nb_pending_commands) {
-        if (0 == nb_routines) {
-            engine_proxy_.notify_idle(0);
-        }
+        set_idle(true);
         return false;
       } else {
-        // Schedule pending commands immediately
-        loop_->send_event(engine_event_id_);
+        // Pending commands are handled at the next iteration
         return true;
       }
     } else {
+      // Surplus work can be taken by a sleeping sibling
+      if (1 < stealable_routines_.size() && 0 < engine_proxy_.nb_idle_threads())
+        engine_proxy_.wake_up_idle_thread();
       // If some routines already are scheduled, then throw an event to force a loop execution
       return true;
     }
@@ -327,54 +570,104 @@ bool thread::execute_scheduled_routines() {
   return true;
 }
 
+bool thread::busy_poll(std::int64_t timeout) {
+  using namespace std::chrono;
+  // Spinning up to the next timer is as good as finding work
+  bool timer_bound = 0 < timeout && timeout <= busy_poll_budget_;
+  auto deadline = high_resolution_clock::now() +
+                  microseconds(timer_bound ? timeout : busy_poll_budget_);
+  while (0 == nb_pending_commands_.load(std::memory_order_acquire)) {
+    // Ready events schedule their routines, they must not be left behind
+    loop_->loop(1, 0);
+    if (!scheduled_routines_.empty())
+      break;
+    if (deadline <= high_resolution_clock::now()) {
+      if (timer_bound)
+        return true;
+      // Spin less while there is nothing to find, but never stop
+      nb_busy_poll_misses_.fetch_add(1, std::memory_order_relaxed);
+      busy_poll_budget_ =
+          std::max<std::int64_t>(busy_poll_budget_ / 2, (busy_poll_max_ + 31) / 32);
+      return false;
+    }
+  }
+  nb_busy_poll_hits_.fetch_add(1, std::memory_order_relaxed);
+  busy_poll_budget_ = std::min(2 * busy_poll_budget_, busy_poll_max_);
+  return true;
+}
+
 void thread::loop() {
   using namespace std::chrono;
   current_thread() = this;
 
-  // Check if we should have a time out
-  int timeout_ms = -1;
+  // Check if we should have a time out, in microseconds. The first round
+  // does not block, so that a thread without work is seen idle and woken
+  // up by busy siblings
+  std::int64_t timeout = 0;
   while (status_ != thread_status::finished) {
+    // Compute next timeout, the clock is only read if we may block
+    if (0 != timeout && !timers_.empty()) {
+      auto next_expiry = timers_.next_expiry();
+      auto now = to_tick(high_resolution_clock::now());
+      timeout = now < next_expiry ? static_cast<std::int64_t>(next_expiry - now) : 0;
+    }
 
+    // Pushers do not wake up a spinning thread, it sees their commands
+    bool polled = 0 != timeout && 0 < busy_poll_budget_ && busy_poll(timeout);
+    if (polled)
+      timeout = 0;
 
-    // Compute next timeout
-    bool fire_timed_out_routines = false;
-    auto first_timed_routines = begin(timed_routines_);
-    if (0 != timeout_ms) {
-      if (first_timed_routines != end(timed_routines_)) {
-        // Compute next timeout
-        timeout_ms =
-            duration_cast<milliseconds>(first_timed_routines->first - high_resolution_clock::now())
-                .count();
-        if (timeout_ms < 0)
-          timeout_ms = 0;
-        if (timeout_ms == 0)
-          fire_timed_out_routines = true;
-      }
+    // Tell pushers we may block, then check nothing was pushed in between
+    if (0 != timeout) {
+      sleeping_.store(true);
+      if (0 < nb_pending_commands_.load())
+        timeout = 0;
     }
 
-    auto return_code = loop_->loop(1, timeout_ms);
+    loop_end_reason return_code = loop_end_reason::max_iter_reached;
+    if (polled) {
+      // The event loop was polled while spinning
+    } else if (0 < timeout && timer_resolution::microseconds == timer_resolution_) {
+      return_code = loop_->loop(1, microseconds(timeout));
+    } else {
+      // Rounded up, so that we do not spin until the deadline
+      return_code = loop_->loop(
+          1, timeout < 0 ? -1 : static_cast<int>(std::min<std::int64_t>(
+                                    (timeout + 999) / 1000, std::numeric_limits<int>::max())));
+    }
+    sleeping_.store(false, std::memory_order_relaxed);
     switch (return_code) {
       case loop_end_reason::max_iter_reached:
         break;
       case loop_end_reason::timed_out:
-        fire_timed_out_routines = true;
         break;
       case loop_end_reason::error_occured:
       default:
         throw exception("Boson unknown error");
         return;
     }
-    if (fire_timed_out_routines) {
-      // Schedule routines that timed out
-      for (auto& timed_routine : first_timed_routines->second.slots) {
-        auto& slot =  suspended_slots_[timed_routine];
-        if (slot.ptr)
-          slot.ptr->get()->event_happened(slot.event_index);
-        suspended_slots_.free(timed_routine);
-      }
-      timed_routines_.erase(first_timed_routines);
-    }
-    timeout_ms = execute_scheduled_routines() ? 0 : -1;
+    // The only clock read of an iteration which does not block
+    now_ = high_resolution_clock::now();
+
+    // Schedule routines that timed out, even if the thread never had to wait
+    if (!timers_.empty())
+      fire_timers();
+
+    // Commands pushed while we were awake did not send any event
+    if (0 < nb_pending_commands_.load(std::memory_order_acquire))
+      handle_engine_event();
+
+    // Engine settings, read after the commands so that new routines see them
+    timer_resolution_ = engine_proxy_.get_engine().get_timer_resolution();
+    clock_mode_ = engine_proxy_.get_engine().get_clock_mode();
+    // The ring is set up by the thread using it
+    uses_io_uring_ = event_backend::io_uring == engine_proxy_.get_engine().get_event_backend() &&
+                     loop_->enable_io_uring();
+    busy_poll_max_ = engine_proxy_.get_engine().get_busy_poll().count();
+    busy_poll_budget_ = 0 == busy_poll_budget_ ? busy_poll_max_
+                                               : std::min(busy_poll_budget_, busy_poll_max_);
+
+    timeout = execute_scheduled_routines() ? 0 : -1;
   }
 
   engine_proxy_.notify_end();
@@ -0,0 +1,138 @@
+#include "internal/timing_wheel.h"
+#include <algorithm>
+#include <cassert>
+
+namespace boson {
+namespace internal {
+
+namespace {
+inline std::size_t first_bit(std::uint64_t bits) {
+  return static_cast<std::size_t>(__builtin_ctzll(bits));
+}
+}
+
+constexpr timing_wheel::handle_t timing_wheel::none;
+
+timing_wheel::timing_wheel(tick_t now) : current_{now} {
+  heads_.fill(none);
+  tails_.fill(none);
+  occupied_slots_.fill(0);
+}
+
+void timing_wheel::link(handle_t handle, std::size_t bucket) {
+  auto& current_node = nodes_[handle];
+  current_node.bucket = bucket;
+  current_node.previous = tails_[bucket];
+  current_node.next = none;
+  if (none != current_node.previous)
+    nodes_[current_node.previous].next = handle;
+  else
+    heads_[bucket] = handle;
+  tails_[bucket] = handle;
+  if (bucket < overflow_bucket)
+    occupied_slots_[bucket / nb_slots] |= std::uint64_t{1} << (bucket % nb_slots);
+}
+
+void timing_wheel::unlink(handle_t handle) {
+  auto& current_node = nodes_[handle];
+  if (none != current_node.previous)
+    nodes_[current_node.previous].next = current_node.next;
+  else
+    heads_[current_node.bucket] = current_node.next;
+  if (none != current_node.next)
+    nodes_[current_node.next].previous = current_node.previous;
+  else
+    tails_[current_node.bucket] = current_node.previous;
+  if (current_node.bucket < overflow_bucket && none == heads_[current_node.bucket])
+    occupied_slots_[current_node.bucket / nb_slots] &=
+        ~(std::uint64_t{1} << (current_node.bucket % nb_slots));
+}
+
+void timing_wheel::place(handle_t handle) {
+  tick_t deadline = std::max(nodes_[handle].deadline, current_);
+  for (std::size_t level = 0; level < nb_levels; ++level) {
+    std::size_t shift = level * level_bits;
+    // Same turn of the upper level
+    if ((deadline >> (shift + level_bits)) == (current_ >> (shift + level_bits))) {
+      link(handle, level * nb_slots + ((deadline >> shift) & (nb_slots - 1)));
+      return;
+    }
+  }
+  link(handle, overflow_bucket);
+}
+
+void timing_wheel::cascade(std::size_t level) {
+  std::size_t bucket = level * nb_slots + ((current_ >> (level * level_bits)) & (nb_slots - 1));
+  handle_t handle = heads_[bucket];
+  heads_[bucket] = tails_[bucket] = none;
+  occupied_slots_[level] &= ~(std::uint64_t{1} << (bucket % nb_slots));
+  while (none != handle) {
+    handle_t next = nodes_[handle].next;
+    place(handle);
+    handle = next;
+  }
+}
+
+void timing_wheel::take_current_slot() {
+  // Overflowing timers get back in the wheel when it starts a new turn
+  if (0 == (current_ & ((tick_t{1} << (nb_levels * level_bits)) - 1))) {
+    handle_t handle = heads_[overflow_bucket];
+    heads_[overflow_bucket] = tails_[overflow_bucket] = none;
+    while (none != handle) {
+      handle_t next = nodes_[handle].next;
+      place(handle);
+      handle = next;
+    }
+  }
+  // Upper levels first, they may fill the lower ones
+  for (std::size_t level = nb_levels - 1; 0 < level; --level) {
+    if (0 == (current_ & ((tick_t{1} << (level * level_bits)) - 1))) cascade(level);
+  }
+
+  std::size_t slot = current_ & (nb_slots - 1);
+  handle_t handle = heads_[slot];
+  if (none == handle) return;
+  occupied_slots_[0] &= ~(std::uint64_t{1} << slot);
+  heads_[expiring_bucket] = handle;
+  tails_[expiring_bucket] = tails_[slot];
+  heads_[slot] = tails_[slot] = none;
+  for (; none != handle; handle = nodes_[handle].next) nodes_[handle].bucket = expiring_bucket;
+}
+
+void timing_wheel::skip_to(tick_t last) {
+  // Ticks before the next expiry have neither timers nor slots to cascade
+  current_ = std::max(current_, std::min(next_expiry(), last));
+}
+
+auto timing_wheel::insert(tick_t deadline, std::size_t value) -> handle_t {
+  handle_t handle = nodes_.allocate();
+  auto& new_node = nodes_[handle];
+  new_node.deadline = deadline;
+  new_node.value = value;
+  place(handle);
+  ++size_;
+  return handle;
+}
+
+void timing_wheel::cancel(handle_t handle) {
+  unlink(handle);
+  nodes_.free(handle);
+  --size_;
+}
+
+auto timing_wheel::next_expiry() const -> tick_t {
+  assert(0 < size_);
+  for (std::size_t level = 0; level < nb_levels; ++level) {
+    if (occupied_slots_[level]) {
+      std::size_t shift = level * level_bits;
+      tick_t turn = (current_ >> (shift + level_bits)) << (shift + level_bits);
+      return turn + (tick_t{first_bit(occupied_slots_[level])} << shift);
+    }
+  }
+  // Only overflowing timers, wake up at the next turn of the wheel
+  std::size_t shift = nb_levels * level_bits;
+  return ((current_ >> shift) + 1) << shift;
+}
+
+}  // namespace internal
+}  // namespace boson
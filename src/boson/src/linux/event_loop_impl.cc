@@ -1,5 +1,7 @@
 #include "event_loop_impl.h"
 #include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
 #include <unistd.h>
 #include <cassert>
 #include <cstring>
@@ -18,40 +20,44 @@ event_loop::fd_data& event_loop::get_fd_data(int fd) {
   return fd_data_[index];
 }
 
-void event_loop::epoll_update(int fd, fd_data& fddata, bool del_if_no_event) {
-  if (events_.size() < events_data_.data().size()) events_.resize(events_data_.data().size());
-  epoll_event_t new_event{(0 <= fddata.idx_read ? EPOLLIN : 0) |
-                              (0 <= fddata.idx_write ? EPOLLOUT : 0) | EPOLLET | EPOLLRDHUP,
-                          {}};
+int event_loop::epoll_add(int fd, std::uint32_t events) {
+  epoll_event_t new_event{events, {}};
   new_event.data.fd = fd;
-  int return_code = -1;
-  if (0 != new_event.events) {
+  int return_code = ::epoll_ctl(loop_fd_, EPOLL_CTL_ADD, fd, &new_event);
+  if (return_code < 0 && EEXIST == errno) {
+    // Still registered from before a generation change, this re-arms the edges
+    errno = 0;
     return_code = ::epoll_ctl(loop_fd_, EPOLL_CTL_MOD, fd, &new_event);
-    if (return_code < 0) {
-      if (ENOENT == errno) {
-        errno = 0;
-        return_code = ::epoll_ctl(loop_fd_, EPOLL_CTL_ADD, fd, &new_event);
-      } else if (EBADF == errno) {
-        // Dispatch panic
-        if (0 <= fddata.idx_read)
-          dispatch_event(fddata.idx_read, -EBADF);
-        if (0 <= fddata.idx_write)
-          dispatch_event(fddata.idx_write, -EBADF);
-      }
-      else {
-        throw exception(std::string("Syscall error (epoll_ctl): ") + ::strerror(errno));
-      }
-    }
+  } else if (0 == return_code) {
+    ++nb_epoll_fds_;
+    if (events_.size() < nb_epoll_fds_) events_.resize(nb_epoll_fds_);
   }
+  return return_code;
 }
 
 void event_loop::dispatch_event(int event_id, event_status status) {
   auto& data = events_data_[event_id];
   switch (data.type) {
-    case event_type::event_fd: {
-      size_t buffer{0};
-      ssize_t nb_bytes = ::read(data.fd, &buffer, 8u);
-      assert(nb_bytes == 8);
+    case event_type::read: {
+      handler_.read(data.fd, data.data, status);
+    } break;
+    case event_type::write: {
+      handler_.write(data.fd, data.data, status);
+    } break;
+  }
+}
+
+void event_loop::dispatch_pending_events() {
+  std::uint64_t words = pending_words_.exchange(0, std::memory_order_acq_rel);
+  while (words) {
+    std::size_t word = __builtin_ctzll(words);
+    words &= words - 1;
+    std::uint64_t events = pending_events_[word].exchange(0, std::memory_order_acq_rel);
+    // Events unregistered in the meantime are dropped
+    events &= registered_events_[word];
+    while (events) {
+      int event_id = static_cast<int>(64 * word + __builtin_ctzll(events));
+      events &= events - 1;
       if (loop_breaker_event_ == event_id) {
         // Empty the queue and send panics
         broken_loop_event_data* data = nullptr;
@@ -63,20 +69,15 @@ void event_loop::dispatch_event(int event_id, event_status status) {
               dispatch_event(fddata.idx_read, -EINTR);
             if (0 <= fddata.idx_write)
               dispatch_event(fddata.idx_write, -EINTR);
+            interrupt_operations(data->fd);
           }
           delete data;
         }
       }
       else {
-        handler_.event(event_id, data.data, status);
+        handler_.event(event_id, events_user_data_[event_id], 0);
       }
-    } break;
-    case event_type::read: {
-      handler_.read(data.fd, data.data, status);
-    } break;
-    case event_type::write: {
-      handler_.write(data.fd, data.data, status);
-    } break;
+    }
   }
 }
 
@@ -84,35 +85,42 @@ event_loop::event_loop(event_handler& handler, int nprocs)
     : handler_{handler},
       loop_fd_{epoll_create1(0)},
       nb_io_registered_(0),
-      trigger_fd_events_{false},
       loop_breaker_event_{-1},
       loop_breaker_queue_{nprocs+1} {
+  for (auto& events : pending_events_) events.store(0, std::memory_order_relaxed);
+  // Edge triggered, it is never read: each write is an edge
+  wakeup_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wakeup_fd_ < 0 || epoll_add(wakeup_fd_, EPOLLIN | EPOLLET) < 0)
+    throw exception(std::string("Syscall error (eventfd): ") + ::strerror(errno));
   loop_breaker_event_ = register_event(nullptr);
 }
 
 event_loop::~event_loop() {
+  if (0 <= timer_fd_) ::close(timer_fd_);
+  ::close(wakeup_fd_);
   ::close(loop_fd_);
 }
 
 int event_loop::register_event(void* data) {
-  // Creates an eventfd
-  int event_fd = ::eventfd(0, 0);
-
-  // Creates users data
-  size_t event_id = static_cast<int>(events_data_.allocate());
-  event_data& ev_data = events_data_[event_id];
-  ev_data.fd = event_fd;
-  ev_data.type = event_type::event_fd;
-  ev_data.data = data;
-  auto& fddata = get_fd_data(event_fd);
-  fddata.idx_read = event_id;
-  noio_events_.insert(event_id);
-
-  // Register
-  epoll_update(event_fd,fddata,false);
+  for (std::size_t word = 0; word < nb_event_words; ++word) {
+    if (~registered_events_[word]) {
+      std::size_t bit = __builtin_ctzll(~registered_events_[word]);
+      registered_events_[word] |= std::uint64_t{1} << bit;
+      std::size_t event_id = 64 * word + bit;
+      if (events_user_data_.size() <= event_id) events_user_data_.resize(event_id + 1);
+      events_user_data_[event_id] = data;
+      return static_cast<int>(event_id);
+    }
+  }
+  throw exception("Too many events registered in the event loop");
+}
 
-  // Casted to int, we dont have to worry about scaling here, int is waaaaay large enough
-  return event_id;
+void* event_loop::unregister_event(int event_id) {
+  std::size_t word = static_cast<std::size_t>(event_id) / 64;
+  std::uint64_t bit = std::uint64_t{1} << (event_id % 64);
+  registered_events_[word] &= ~bit;
+  pending_events_[word].fetch_and(~bit, std::memory_order_relaxed);
+  return events_user_data_[event_id];
 }
 
 void* event_loop::get_data(int event_id) {
@@ -128,13 +136,13 @@ std::tuple<int,int> event_loop::get_events(int fd) {
 }
 
 void event_loop::send_event(int event) {
-  auto& data = events_data_[static_cast<size_t>(event)];
-  size_t buffer{1};
-  ssize_t nb_bytes = ::write(data.fd, &buffer, 8u);
-  if (nb_bytes < 0) {
+  std::size_t word = static_cast<std::size_t>(event) / 64;
+  pending_events_[word].fetch_or(std::uint64_t{1} << (event % 64), std::memory_order_release);
+  // If some word was pending, its sender woke the loop up and it did not dispatch yet
+  if (0 != pending_words_.fetch_or(std::uint64_t{1} << word, std::memory_order_acq_rel)) return;
+  std::uint64_t buffer{1};
+  if (::write(wakeup_fd_, &buffer, sizeof(buffer)) < 0 && EAGAIN != errno)
     throw exception(std::string("Syscall error (write): ") + strerror(errno));
-  }
-  trigger_fd_events_.store(true, std::memory_order_release);
 }
 
 int event_loop::register_read(int fd, void* data) {
@@ -147,8 +155,8 @@ int event_loop::register_read(int fd, void* data) {
   auto& fddata = get_fd_data(fd);
   fddata.idx_read = event_id;
 
-  // Register in epoll loop
-  epoll_update(fd,fddata,false);
+  // Register in epoll loop, once for the fd lifetime
+  watch(fd, fddata.generation);
 
   ++nb_io_registered_;
   return event_id;
@@ -164,8 +172,8 @@ int event_loop::register_write(int fd, void* data) {
   auto& fddata = get_fd_data(fd);
   fddata.idx_write = event_id;
 
-  // Register in epoll loop
-  epoll_update(fd,fddata,false);
+  // Register in epoll loop, once for the fd lifetime
+  watch(fd, fddata.generation);
 
   ++nb_io_registered_;
   return event_id;
@@ -174,77 +182,283 @@ int event_loop::register_write(int fd, void* data) {
 void* event_loop::unregister(int event_id) {
   auto& event_data = events_data_[event_id];
   auto& fddata = get_fd_data(event_data.fd);
-  if (event_data.type == event_type::read || event_data.type == event_type::event_fd)
+  if (event_data.type == event_type::read)
     fddata.idx_read = -1;
-  else if (event_data.type == event_type::write)
+  else
     fddata.idx_write = -1;
 
-  //epoll_update(event_data.fd, fddata,true);
-  epoll_update(event_data.fd, fddata, false);
-  if (event_data.type == event_type::event_fd)
-    noio_events_.erase(event_id);
-  else
-    --nb_io_registered_;
+  // The fd stays watched, further edges only update its readiness
+  --nb_io_registered_;
   void* data = event_data.data;
   events_data_.free(event_id);
   return data;
 }
 
+void event_loop::watch(int fd, std::uint32_t generation) {
+  auto& fddata = get_fd_data(fd);
+  if (fddata.watched && fddata.generation == generation) return;
+  fddata.generation = generation;
+  fddata.readable = false;
+  fddata.writable = false;
+  fddata.error_queue = false;
+  nb_fd_registrations_.fetch_add(1, std::memory_order_relaxed);
+  if (0 == epoll_add(fd, EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP)) {
+    fddata.watched = true;
+  } else if (EBADF == errno) {
+    // Dispatch panic
+    fddata.watched = false;
+    if (0 <= fddata.idx_read)
+      dispatch_event(fddata.idx_read, -EBADF);
+    if (0 <= fddata.idx_write)
+      dispatch_event(fddata.idx_write, -EBADF);
+  } else {
+    throw exception(std::string("Syscall error (epoll_ctl): ") + ::strerror(errno));
+  }
+}
+
+bool event_loop::consume_readiness(int fd, bool is_read) {
+  auto& fddata = get_fd_data(fd);
+  bool& ready = is_read ? fddata.readable : fddata.writable;
+  bool was_ready = ready;
+  ready = false;
+  return was_ready;
+}
+
+void event_loop::watch_error_queue(int fd) {
+  get_fd_data(fd).error_queue = true;
+}
+
+std::size_t event_loop::nb_fd_registrations() const {
+  return nb_fd_registrations_.load(std::memory_order_relaxed);
+}
+
+bool event_loop::enable_io_uring() {
+  if (!ring_ && !io_uring_failed_) {
+    try {
+      ring_.reset(new io_ring{256});
+    } catch (exception const&) {
+      io_uring_failed_ = true;
+    }
+  }
+  return static_cast<bool>(ring_);
+}
+
+void event_loop::submit(io_operation const& operation, void* data, int timeout_ms) {
+  assert(ring_);
+  auto& fddata = get_fd_data(operation.fd);
+  std::size_t operation_id = operations_.allocate();
+  operations_[operation_id] = operation_data{operation.fd, data, fddata.nb_interrupts};
+  ++fddata.nb_operations;
+  ++nb_operations_;
+  nb_io_operations_.fetch_add(1, std::memory_order_relaxed);
+  if (0 <= timeout_ms) {
+    timespec timeout{timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+    ring_->queue_operation(operation, operation_id, &timeout, ignored_tag);
+  } else {
+    ring_->queue_operation(operation, operation_id, nullptr, ignored_tag);
+  }
+}
+
+void event_loop::interrupt_operations(int fd) {
+  if (!ring_ || fd_data_.size() <= static_cast<size_t>(fd)) return;
+  auto& fddata = get_fd_data(fd);
+  if (0 == fddata.nb_operations) return;
+  ++fddata.nb_interrupts;
+  ring_->queue_cancel(fd, ignored_tag);
+}
+
+std::size_t event_loop::nb_io_operations() const {
+  return nb_io_operations_.load(std::memory_order_relaxed);
+}
+
 void event_loop::send_fd_panic(int proc_from,int fd) {
   loop_breaker_queue_.write(proc_from+1, new broken_loop_event_data{fd});
   send_event(loop_breaker_event_);
 }
 
+int event_loop::wait_events(int timeout_ms, timespec const* precise_timeout) {
+  int nb_events = 0;
+  if (!precise_timeout) {
+    nb_events = ::epoll_wait(loop_fd_, events_.data(), events_.size(), timeout_ms);
+  }
+#ifdef SYS_epoll_pwait2
+  else if (has_epoll_pwait2_) {
+    nb_events = ::syscall(SYS_epoll_pwait2, loop_fd_, events_.data(), events_.size(),
+                          precise_timeout, nullptr, 0);
+    if (nb_events < 0 && ENOSYS == errno) {
+      // Kernel older than 5.11, fall back to the timer fd
+      has_epoll_pwait2_ = false;
+      errno = 0;
+      return wait_events(timeout_ms, precise_timeout);
+    }
+  }
+#endif
+  else {
+    if (timer_fd_ < 0) {
+      timer_fd_ = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+      if (timer_fd_ < 0)
+        throw exception(std::string("Syscall error (timerfd_create): ") + ::strerror(errno));
+      epoll_add(timer_fd_, EPOLLIN);
+    }
+    // A null value would disarm the timer
+    itimerspec timer_value{{0, 0}, *precise_timeout};
+    if (0 == timer_value.it_value.tv_sec && 0 == timer_value.it_value.tv_nsec)
+      timer_value.it_value.tv_nsec = 1;
+    ::timerfd_settime(timer_fd_, 0, &timer_value, nullptr);
+    nb_events = ::epoll_wait(loop_fd_, events_.data(), events_.size(), -1);
+  }
+
+  // The timer fd may also fire during a later wait, it is never dispatched
+  if (0 <= timer_fd_) {
+    for (int index = 0; index < nb_events; ++index) {
+      if (events_[index].data.fd == timer_fd_) {
+        std::uint64_t nb_expirations = 0;
+        ssize_t nb_bytes = ::read(timer_fd_, &nb_expirations, sizeof(nb_expirations));
+        static_cast<void>(nb_bytes);
+        events_[index] = events_[--nb_events];
+        break;
+      }
+    }
+  }
+  return nb_events;
+}
+
+void event_loop::dispatch_epoll_events(int nb_events) {
+  for (int index = 0; index < nb_events; ++index) {
+    auto& epoll_event = events_[index];
+    // Notifications are dispatched after the wait
+    if (wakeup_fd_ == epoll_event.data.fd) continue;
+    auto& fddata = get_fd_data(epoll_event.data.fd);
+    // Edges are only reported once, they are kept if nobody waits for them
+    // A shut down listening socket only reports EPOLLHUP
+    // Zero copy completions come with EPOLLERR, syscalls tell if there is a real error
+    std::uint32_t hang_up_events = EPOLLHUP | EPOLLRDHUP | (fddata.error_queue ? 0 : EPOLLERR);
+    bool notified = (epoll_event.events & EPOLLERR) && !(epoll_event.events & hang_up_events);
+    if (epoll_event.events & hang_up_events) {
+      //boson::debug::log("Yeah HANG UP {}", epoll_event.data.fd);
+      fddata.readable = fddata.writable = true;
+      if (0 <= fddata.idx_read && !(epoll_event.events & EPOLLIN))
+        dispatch_event(fddata.idx_read, -EINTR);
+      if (0 <= fddata.idx_write)
+        dispatch_event(fddata.idx_write, -EINTR);
+    }
+    else if ((epoll_event.events & EPOLLOUT) || notified) {
+      fddata.writable = true;
+      if (0 <= fddata.idx_write)
+        dispatch_event(fddata.idx_write, 0);
+    }
+    if ((epoll_event.events & EPOLLIN) || notified) {
+      fddata.readable = true;
+      if (0 <= fddata.idx_read)
+        dispatch_event(fddata.idx_read, 0);
+    }
+  }
+}
+
+int event_loop::wait_ring(int timeout_ms, timespec const* precise_timeout) {
+  if (!epoll_polled_) {
+    ring_->queue_poll(loop_fd_, epoll_ready_tag);
+    epoll_polled_ = true;
+  }
+  if (!ring_->has_completions() && (precise_timeout || 0 != timeout_ms)) {
+    timespec timeout{timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+    if (precise_timeout) timeout = *precise_timeout;
+    ring_->enter(true, 0 <= timeout_ms || precise_timeout ? &timeout : nullptr);
+  } else if (ring_->needs_enter()) {
+    ring_->enter(false, nullptr);
+  }
+
+  int nb_dispatched = 0;
+  bool epoll_ready = false;
+  std::uint64_t user_data = 0;
+  int result = 0;
+  while (ring_->pop_completion(user_data, result)) {
+    if (epoll_ready_tag == user_data) {
+      epoll_polled_ = false;
+      epoll_ready = true;
+    } else if (ignored_tag != user_data) {
+      auto operation = operations_[user_data];
+      operations_.free(user_data);
+      --nb_operations_;
+      auto& fddata = get_fd_data(operation.fd);
+      --fddata.nb_operations;
+      if (-ECANCELED == result)
+        result = operation.nb_interrupts == fddata.nb_interrupts ? -ETIMEDOUT : -EINTR;
+      handler_.completion(operation.data, result);
+      ++nb_dispatched;
+    }
+  }
+
+  if (epoll_ready) {
+    int nb_events = wait_events(0, nullptr);
+    dispatch_epoll_events(nb_events);
+    nb_dispatched += std::max(nb_events, 0);
+  }
+  return nb_dispatched;
+}
+
 loop_end_reason event_loop::loop(int max_iter, int timeout_ms) {
+  return loop(max_iter, timeout_ms, nullptr);
+}
+
+loop_end_reason event_loop::loop(int max_iter, std::chrono::microseconds timeout) {
+  using namespace std::chrono;
+  // Whole milliseconds do not need the precise wait
+  if (timeout.count() < 0) return loop(max_iter, -1, nullptr);
+  if (0 == timeout.count() % 1000)
+    return loop(max_iter, static_cast<int>(duration_cast<milliseconds>(timeout).count()), nullptr);
+  timespec precise_timeout{static_cast<time_t>(duration_cast<seconds>(timeout).count()),
+                           static_cast<long>((timeout % seconds(1)).count() * 1000)};
+  return loop(max_iter, -1, &precise_timeout);
+}
+
+loop_end_reason event_loop::loop(int max_iter, int timeout_ms, timespec const* precise_timeout) {
   bool forever = (-1 == max_iter);
   bool retry = false;
   for (size_t index = 0; index < static_cast<size_t>(max_iter) || forever || retry; ++index) {
     int return_code = 0;
     retry = false;
-    if (0 != timeout_ms || 0 < nb_io_registered_ ||
-        trigger_fd_events_.load(std::memory_order_acquire)) {
-      trigger_fd_events_.store(false, std::memory_order_relaxed);
-      return_code = ::epoll_wait(loop_fd_, events_.data(), events_.size(), timeout_ms);
-      switch (return_code) {
-        case 0:
-          if (timeout_ms != 0)
-            return loop_end_reason::timed_out;
-          else
-            break;
-        case EINTR:
-          //throw exception(std::string("Syscall error (epoll_wait) EINTR : ") + ::strerror(errno));
-          // TODO: real cause to be determined, happens under high contention
-          retry = true;
-          break;
-        case EBADF:
-          //throw exception(std::string("Syscall error (epoll_wait) EBADF : ") + std::to_string(loop_fd_) + ::strerror(errno));
-          retry = true;
-          break;
-        case EFAULT:
-          throw exception(std::string("Syscall error (epoll_wait) EFAULT : ") + ::strerror(errno));
-        case EINVAL:
-          throw exception(std::string("Syscall error (epoll_wait) EINVAL : ") + ::strerror(errno));
-        default:
-          break;
+    // Pending notifications must not wait
+    bool has_pending = 0 != pending_words_.load(std::memory_order_acquire);
+    int wait_timeout_ms = has_pending ? 0 : timeout_ms;
+    timespec const* wait_precise_timeout = has_pending ? nullptr : precise_timeout;
+    if (ring_) {
+      // The ring also has to submit and reap operations, which is free if there are none
+      if (wait_precise_timeout || 0 != wait_timeout_ms || 0 < nb_io_registered_ ||
+          0 < nb_operations_ || ring_->needs_enter() || ring_->has_completions()) {
+        if (0 == wait_ring(wait_timeout_ms, wait_precise_timeout) && wait_timeout_ms != 0)
+          return loop_end_reason::timed_out;
       }
-      // Success, get on on with dispatching events
-      for (int index = 0; index < return_code; ++index) {
-        auto& epoll_event = events_[index];
-        auto& fddata = get_fd_data(epoll_event.data.fd);
-        if (epoll_event.events & (EPOLLERR | EPOLLRDHUP)) {
-          //boson::debug::log("Yeah HANG UP {}", epoll_event.data.fd);
-          if (0 < fddata.idx_read && !(epoll_event.events & EPOLLIN))
-            dispatch_event(fddata.idx_read, -EINTR);
-          if (0 < fddata.idx_write)
-            dispatch_event(fddata.idx_write, -EINTR);
-        }
-        else if (epoll_event.events & EPOLLOUT) {
-          dispatch_event(fddata.idx_write, 0);
+    }
+    else if (wait_precise_timeout || 0 != wait_timeout_ms || 0 < nb_io_registered_) {
+      return_code = wait_events(wait_timeout_ms, wait_precise_timeout);
+      if (0 == return_code && wait_timeout_ms != 0)
+        return loop_end_reason::timed_out;
+      // The number of events is not an error code
+      if (return_code < 0) {
+        switch (errno) {
+          case EINTR:
+            //throw exception(std::string("Syscall error (epoll_wait) EINTR : ") + ::strerror(errno));
+            // TODO: real cause to be determined, happens under high contention
+            retry = true;
+            break;
+          case EBADF:
+            //throw exception(std::string("Syscall error (epoll_wait) EBADF : ") + std::to_string(loop_fd_) + ::strerror(errno));
+            retry = true;
+            break;
+          case EFAULT:
+            throw exception(std::string("Syscall error (epoll_wait) EFAULT : ") + ::strerror(errno));
+          case EINVAL:
+            throw exception(std::string("Syscall error (epoll_wait) EINVAL : ") + ::strerror(errno));
+          default:
+            break;
         }
-        if (epoll_event.events & EPOLLIN)
-          dispatch_event(fddata.idx_read, 0);
+        return_code = 0;
       }
+      // Success, get on on with dispatching events
+      dispatch_epoll_events(return_code);
     }
+    if (0 != pending_words_.load(std::memory_order_acquire)) dispatch_pending_events();
   }
   return loop_end_reason::max_iter_reached;
 }
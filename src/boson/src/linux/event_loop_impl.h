@@ -3,12 +3,17 @@
 #pragma once
 
 #include <sys/epoll.h>
+#include <time.h>
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
 #include <vector>
 #include "event_loop.h"
+#include "io_ring.h"
 #include "system.h"
 #include "memory/sparse_vector.h"
-#include "memory/flat_unordered_set.h"
 #include "queues/simple.h"
 
 namespace boson {
@@ -21,7 +26,7 @@ using epoll_event_t = struct epoll_event;
  * meaning
  */
 class event_loop {
-  enum class event_type { event_fd, read, write };
+  enum class event_type { read, write };
 
   struct event_data {
     int fd;
@@ -33,6 +38,13 @@ class event_loop {
   struct fd_data {
     int idx_read;
     int idx_write;
+    bool watched{false};         // Registered in epoll for reads and writes
+    std::uint32_t generation{0};  // File behind the fd number when it got watched
+    bool readable{false};        // Edges seen since the last consume_readiness
+    bool writable{false};
+    bool error_queue{false};     // EPOLLERR may only mean notifications in the error queue
+    std::uint32_t nb_operations{0};  // Operations in the ring
+    std::uint32_t nb_interrupts{0};  // Cancellations of these operations
 
     inline fd_data() : idx_read{-1}, idx_write{-1} {}
     inline fd_data(int r, int w) : idx_read{r}, idx_write{w} {}
@@ -42,6 +54,16 @@ class event_loop {
     int fd;
   };
 
+  struct operation_data {
+    int fd;
+    void* data;
+    std::uint32_t nb_interrupts;  // Of the fd, when submitted
+  };
+
+  // Completions which are not operations
+  static constexpr std::uint64_t epoll_ready_tag = ~std::uint64_t{0};
+  static constexpr std::uint64_t ignored_tag = ~std::uint64_t{0} - 1;
+
   event_handler& handler_;
 
   // epoll fd
@@ -50,9 +72,21 @@ class event_loop {
  // Data attached to each event
   memory::sparse_vector<event_data> events_data_;
 
-  // List of event fd events
-  memory::flat_unordered_set<int> noio_events_;
-  
+  /**
+   * Notification events
+   *
+   * They share a single eventfd. Senders set the pending bit of their
+   * event, and the bit of its word in pending_words_, then only write to
+   * the eventfd if no other word was pending. Event ids are the bit
+   * indexes.
+   */
+  static constexpr std::size_t nb_event_words = 64;
+  int wakeup_fd_{-1};
+  std::atomic<std::uint64_t> pending_words_{0};
+  std::array<std::atomic<std::uint64_t>, nb_event_words> pending_events_;
+  std::array<std::uint64_t, nb_event_words> registered_events_{};
+  std::vector<void*> events_user_data_;
+
   /**
    * FD data is a join table of FDs to distinguish events used by more than one routine
    *
@@ -72,14 +106,42 @@ class event_loop {
    */
   size_t nb_io_registered_;
 
-  // A flag to avoid an epoll_wait if possible
-  std::atomic<bool> trigger_fd_events_;
+  // Number of fds in the epoll table, epoll_wait returns at most one event for each
+  size_t nb_epoll_fds_{0};
+
+  // epoll_ctl calls for fds, read by other threads for statistics
+  std::atomic<std::size_t> nb_fd_registrations_{0};
 
   // Private event to implement the fd panic feature
   int loop_breaker_event_;
 
   // Data used when loop is broken
   queues::simple_void_queue loop_breaker_queue_;
+
+  /**
+   * Precise timeouts
+   *
+   * They use epoll_pwait2 if the kernel has it, or a timer fd armed
+   * before each wait otherwise. The timer fd is created on first use.
+   */
+  bool has_epoll_pwait2_{true};
+  int timer_fd_{-1};
+
+  /**
+   * io_uring, if enabled
+   *
+   * The epoll fd is polled through the ring, so that fds waited for
+   * readiness and event fds keep working. Its events are harvested
+   * without waiting once the poll completes.
+   */
+  std::unique_ptr<io_ring> ring_;
+  bool io_uring_failed_{false};
+  bool epoll_polled_{false};
+  memory::sparse_vector<operation_data> operations_;
+  size_t nb_operations_{0};
+
+  // Operations submitted, read by other threads for statistics
+  std::atomic<std::size_t> nb_io_operations_{0};
   
   /**
    * Retrieve the event_data for read and write matching this fd
@@ -87,34 +149,121 @@ class event_loop {
   fd_data& get_fd_data(int fd);
 
   /**
-   * Update the epoll table
+   * Adds a fd to the epoll table
    */
-  void epoll_update(int fd, fd_data& fddata, bool del_if_no_event);
+  int epoll_add(int fd, std::uint32_t events);
 
   /**
-   * Update the epoll table
+   * Signal the event to be dispatched to the handler
    */
-  inline void epoll_update(int fd, bool del_if_no_event) {
-    epoll_update(fd, get_fd_data(fd), del_if_no_event);
-  }
+  void dispatch_event(int event_id, event_status status);
 
   /**
-   * Signal the event to be dispatched to the handler
+   * Waits for epoll events, with a precise timeout if not null
+   *
+   * Returns the number of events, timer fd expirations excluded
    */
-  void dispatch_event(int event_id, event_status status);
+  int wait_events(int timeout_ms, timespec const* precise_timeout);
+
+  /**
+   * Dispatches the notification events sent since the last call
+   */
+  void dispatch_pending_events();
+
+  /**
+   * Dispatches the epoll events stored in events_
+   */
+  void dispatch_epoll_events(int nb_events);
+
+  /**
+   * Submits queued operations and waits for completions, in one syscall
+   *
+   * Returns the number of completions and epoll events dispatched.
+   */
+  int wait_ring(int timeout_ms, timespec const* precise_timeout);
+
+  loop_end_reason loop(int max_iter, int timeout_ms, timespec const* precise_timeout);
 
  public:
+  static constexpr std::size_t max_nb_events = 64 * nb_event_words;
+
   event_loop(event_handler& handler, int nb_procs);
   ~event_loop();
+
+  /**
+   * Registers a notification event, no fd is created for it
+   *
+   * Throws once max_nb_events are registered.
+   */
   int register_event(void* data);
+  void* unregister_event(int event_id);
+
+  /**
+   * Notifies the event, from any thread
+   *
+   * Notifications sent before the event is dispatched are merged.
+   */
+  void send_event(int event);
+
   void* get_data(int event_id);
   std::tuple<int,int> get_events(int fd);
-  void send_event(int event);
   int register_read(int fd, void* data);
   int register_write(int fd, void* data);
   void* unregister(int event_id);
+
+  /**
+   * Registers the fd in epoll for its lifetime, if not done yet
+   *
+   * Registration is edge triggered for both reads and writes, read and
+   * write events only attach a handler to it. The generation identifies
+   * the file behind the fd number, a new one means the fd has been
+   * closed and the number reused.
+   */
+  void watch(int fd, std::uint32_t generation);
+
+  /**
+   * Tells if an edge was seen since the last call, and forgets it
+   */
+  bool consume_readiness(int fd, bool is_read);
+
+  /**
+   * Tells that the error queue of the fd receives notifications
+   *
+   * This is the case of zero copy completions. EPOLLERR then makes the
+   * fd ready instead of interrupting its waiters, their syscalls report
+   * the actual errors. The fd must be watched, a new generation forgets
+   * it.
+   */
+  void watch_error_queue(int fd);
+
+  std::size_t nb_fd_registrations() const;
+
+  /**
+   * Sets io_uring up for this loop, if not done yet
+   *
+   * Returns false if the kernel does not support it, the loop then
+   * keeps using epoll alone.
+   */
+  bool enable_io_uring();
+
+  /**
+   * Queues an operation in the ring, it is submitted at the next iteration
+   *
+   * Its completion is given to the handler with the syscall result. A
+   * timeout expiring first ends it with -ETIMEDOUT, an interruption
+   * with -EINTR. The ring must be enabled.
+   */
+  void submit(io_operation const& operation, void* data, int timeout_ms);
+
+  /**
+   * Cancels the operations on the fd, they complete with -EINTR
+   */
+  void interrupt_operations(int fd);
+
+  std::size_t nb_io_operations() const;
   void send_fd_panic(int proc_from, int fd);
   loop_end_reason loop(int max_iter = -1, int timeout_ms = -1);
+  loop_end_reason loop(int max_iter, std::chrono::microseconds timeout);
 };
 }
 
@@ -0,0 +1,277 @@
+#include "io_ring.h"
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include "exception.h"
+#ifdef BOSON_HAS_IO_URING
+#include <linux/io_uring.h>
+#endif
+
+namespace boson {
+
+#ifdef BOSON_HAS_IO_URING
+namespace {
+inline unsigned* ring_field(void* rings, unsigned offset) {
+  return reinterpret_cast<unsigned*>(static_cast<char*>(rings) + offset);
+}
+
+inline std::uint8_t operation_code(io_operation_type type) {
+  switch (type) {
+    case io_operation_type::read:
+      return IORING_OP_READ;
+    case io_operation_type::write:
+      return IORING_OP_WRITE;
+    case io_operation_type::accept:
+      return IORING_OP_ACCEPT;
+    case io_operation_type::connect:
+      return IORING_OP_CONNECT;
+    case io_operation_type::send:
+      return IORING_OP_SEND;
+    case io_operation_type::recv:
+      return IORING_OP_RECV;
+    case io_operation_type::readv:
+      return IORING_OP_READV;
+    case io_operation_type::writev:
+      return IORING_OP_WRITEV;
+    case io_operation_type::sendmsg:
+      return IORING_OP_SENDMSG;
+    case io_operation_type::recvmsg:
+      return IORING_OP_RECVMSG;
+    case io_operation_type::fsync:
+      return IORING_OP_FSYNC;
+  }
+  return IORING_OP_NOP;
+}
+}  // namespace
+
+io_ring::io_ring(unsigned nb_entries) {
+  io_uring_params parameters;
+  std::memset(&parameters, 0, sizeof(parameters));
+  // Completions are only handled between two scheduler iterations, there is
+  // no need to interrupt the thread for them
+  parameters.flags = IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG;
+  ring_fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, nb_entries, &parameters));
+  if (ring_fd_ < 0 && EINVAL == errno)
+    throw exception("io_uring lacks some features, Linux 5.19 is needed");
+  if (ring_fd_ < 0)
+    throw exception(std::string("Syscall error (io_uring_setup): ") + ::strerror(errno));
+  if (!(parameters.features & IORING_FEAT_SINGLE_MMAP) ||
+      !(parameters.features & IORING_FEAT_EXT_ARG) || !(parameters.features & IORING_FEAT_NODROP)) {
+    ::close(ring_fd_);
+    throw exception("io_uring lacks some features, Linux 5.19 is needed");
+  }
+
+  rings_size_ = std::max(parameters.sq_off.array + parameters.sq_entries * sizeof(unsigned),
+                         parameters.cq_off.cqes + parameters.cq_entries * sizeof(io_uring_cqe));
+  rings_ = ::mmap(nullptr, rings_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  ring_fd_, IORING_OFF_SQ_RING);
+  sqes_size_ = parameters.sq_entries * sizeof(io_uring_sqe);
+  sqes_ = rings_ == MAP_FAILED ? MAP_FAILED
+                               : ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+  if (rings_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+    std::string message = std::string("Syscall error (mmap): ") + ::strerror(errno);
+    if (rings_ != MAP_FAILED) ::munmap(rings_, rings_size_);
+    ::close(ring_fd_);
+    throw exception(message);
+  }
+
+  nb_entries_ = parameters.sq_entries;
+  sq_mask_ = *ring_field(rings_, parameters.sq_off.ring_mask);
+  cq_mask_ = *ring_field(rings_, parameters.cq_off.ring_mask);
+  sq_head_ = ring_field(rings_, parameters.sq_off.head);
+  sq_tail_ = ring_field(rings_, parameters.sq_off.tail);
+  sq_flags_ = ring_field(rings_, parameters.sq_off.flags);
+  cq_head_ = ring_field(rings_, parameters.cq_off.head);
+  cq_tail_ = ring_field(rings_, parameters.cq_off.tail);
+  cqes_ = static_cast<char*>(rings_) + parameters.cq_off.cqes;
+  sqe_tail_ = *sq_tail_;
+
+  // Entries are used in order, the indirection array never changes
+  unsigned* sq_array = ring_field(rings_, parameters.sq_off.array);
+  for (unsigned index = 0; index < nb_entries_; ++index) sq_array[index] = index;
+  timeouts_.resize(nb_entries_);
+
+  // Closing a fd cancels its operations by fd, without it their routines would never wake up
+  std::uint64_t user_data = 0;
+  int result = -EINVAL;
+  queue_cancel(ring_fd_, 0);
+  if (submit(1, IORING_ENTER_GETEVENTS, nullptr) < 0 || !pop_completion(user_data, result) ||
+      -EINVAL == result) {
+    ::munmap(sqes_, sqes_size_);
+    ::munmap(rings_, rings_size_);
+    ::close(ring_fd_);
+    throw exception("io_uring cannot cancel operations by fd, Linux 5.19 is needed");
+  }
+}
+
+io_ring::~io_ring() {
+  ::munmap(sqes_, sqes_size_);
+  ::munmap(rings_, rings_size_);
+  ::close(ring_fd_);
+}
+
+int io_ring::submit(unsigned min_complete, unsigned flags, void const* argument) {
+  __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+  unsigned nb_queued = sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+  return static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd_, nb_queued, min_complete,
+                                    flags, argument, sizeof(io_uring_getevents_arg)));
+}
+
+void io_ring::reserve(unsigned nb_sqes) {
+  if (nb_entries_ - (sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE)) >= nb_sqes) return;
+  // Completions are kept by the kernel if they overflow, this may only fail on memory shortage
+  if (submit(0, 0, nullptr) < 0 ||
+      nb_entries_ - (sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE)) < nb_sqes)
+    throw exception(std::string("Syscall error (io_uring_enter): ") + ::strerror(errno));
+}
+
+void* io_ring::next_sqe() {
+  auto sqe = static_cast<io_uring_sqe*>(sqes_) + (sqe_tail_++ & sq_mask_);
+  std::memset(sqe, 0, sizeof(io_uring_sqe));
+  return sqe;
+}
+
+void io_ring::queue_operation(io_operation const& operation, std::uint64_t user_data,
+                              timespec const* timeout, std::uint64_t timeout_user_data) {
+  reserve(timeout ? 2 : 1);
+  auto sqe = static_cast<io_uring_sqe*>(next_sqe());
+  sqe->opcode = operation_code(operation.type);
+  sqe->fd = operation.fd;
+  sqe->addr = reinterpret_cast<std::uint64_t>(operation.buffer);
+  sqe->user_data = user_data;
+  switch (operation.type) {
+    case io_operation_type::read:
+    case io_operation_type::write:
+    case io_operation_type::readv:
+    case io_operation_type::writev:
+      // Like the syscalls, at the current file position unless an offset is given
+      sqe->len = static_cast<unsigned>(operation.size);
+      sqe->off = static_cast<std::uint64_t>(operation.offset);
+      break;
+    case io_operation_type::send:
+    case io_operation_type::recv:
+      sqe->len = static_cast<unsigned>(operation.size);
+      sqe->msg_flags = static_cast<unsigned>(operation.flags);
+      break;
+    case io_operation_type::sendmsg:
+    case io_operation_type::recvmsg:
+      sqe->len = 1;
+      sqe->msg_flags = static_cast<unsigned>(operation.flags);
+      break;
+    case io_operation_type::accept:
+      sqe->addr2 = reinterpret_cast<std::uint64_t>(operation.size_pointer);
+      sqe->accept_flags = static_cast<unsigned>(operation.flags);
+      break;
+    case io_operation_type::connect:
+      sqe->off = operation.size;
+      break;
+    case io_operation_type::fsync:
+      break;
+  }
+
+  if (timeout) {
+    sqe->flags |= IOSQE_IO_LINK;
+    unsigned index = sqe_tail_ & sq_mask_;
+    timeouts_[index] = kernel_timespec{timeout->tv_sec, timeout->tv_nsec};
+    auto timeout_sqe = static_cast<io_uring_sqe*>(next_sqe());
+    timeout_sqe->opcode = IORING_OP_LINK_TIMEOUT;
+    timeout_sqe->fd = -1;
+    timeout_sqe->addr = reinterpret_cast<std::uint64_t>(&timeouts_[index]);
+    timeout_sqe->len = 1;
+    timeout_sqe->user_data = timeout_user_data;
+  }
+}
+
+void io_ring::queue_poll(int fd, std::uint64_t user_data) {
+  reserve(1);
+  auto sqe = static_cast<io_uring_sqe*>(next_sqe());
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = POLLIN;
+  sqe->user_data = user_data;
+}
+
+void io_ring::queue_cancel(int fd, std::uint64_t user_data) {
+  reserve(1);
+  auto sqe = static_cast<io_uring_sqe*>(next_sqe());
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = fd;
+  sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+  sqe->user_data = user_data;
+}
+
+bool io_ring::needs_enter() const {
+  return sqe_tail_ != __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) ||
+         (__atomic_load_n(sq_flags_, __ATOMIC_RELAXED) &
+          (IORING_SQ_TASKRUN | IORING_SQ_CQ_OVERFLOW));
+}
+
+bool io_ring::has_completions() const {
+  return *cq_head_ != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+}
+
+void io_ring::enter(bool wait, timespec const* timeout) {
+  kernel_timespec wait_timeout{0, 0};
+  io_uring_getevents_arg argument{0, _NSIG / 8, 0, 0};
+  if (timeout) {
+    wait_timeout = kernel_timespec{timeout->tv_sec, timeout->tv_nsec};
+    argument.ts = reinterpret_cast<std::uint64_t>(&wait_timeout);
+  }
+  int return_code = submit(wait ? 1 : 0, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &argument);
+  if (return_code < 0 && ETIME != errno && EINTR != errno && EBUSY != errno)
+    throw exception(std::string("Syscall error (io_uring_enter): ") + ::strerror(errno));
+}
+
+bool io_ring::pop_completion(std::uint64_t& user_data, int& result) {
+  unsigned head = *cq_head_;
+  if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) return false;
+  auto& cqe = static_cast<io_uring_cqe*>(cqes_)[head & cq_mask_];
+  user_data = cqe.user_data;
+  result = cqe.res;
+  __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+#else
+
+io_ring::io_ring(unsigned) {
+  throw exception("io_uring is not supported by the kernel headers boson was built with");
+}
+
+io_ring::~io_ring() {
+}
+
+void io_ring::queue_operation(io_operation const&, std::uint64_t, timespec const*,
+                              std::uint64_t) {
+}
+
+void io_ring::queue_poll(int, std::uint64_t) {
+}
+
+void io_ring::queue_cancel(int, std::uint64_t) {
+}
+
+bool io_ring::needs_enter() const {
+  return false;
+}
+
+bool io_ring::has_completions() const {
+  return false;
+}
+
+void io_ring::enter(bool, timespec const*) {
+}
+
+bool io_ring::pop_completion(std::uint64_t&, int&) {
+  return false;
+}
+
+#endif
+
+}  // namespace boson
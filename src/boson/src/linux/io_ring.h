@@ -0,0 +1,115 @@
+#ifndef BOSON_IORING_H_
+#define BOSON_IORING_H_
+#pragma once
+
+#include <time.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "event_loop.h"
+
+namespace boson {
+
+/**
+ * io_uring instance of an event loop
+ *
+ * The ring is set up with raw syscalls, so boson does not depend on
+ * liburing. Entries are queued in the shared submission ring and only
+ * reach the kernel at the next enter(), which also waits for
+ * completions: a loop iteration costs a single syscall.
+ */
+class io_ring {
+  // Same layout as the kernel timespec, which is always 64 bits
+  struct kernel_timespec {
+    std::int64_t tv_sec;
+    long long tv_nsec;
+  };
+
+  int ring_fd_{-1};
+  void* rings_{nullptr};  // Submission and completion rings, mapped at once
+  std::size_t rings_size_{0};
+  void* sqes_{nullptr};
+  std::size_t sqes_size_{0};
+  unsigned nb_entries_{0};
+  unsigned sq_mask_{0};
+  unsigned cq_mask_{0};
+  unsigned* sq_head_{nullptr};
+  unsigned* sq_tail_{nullptr};
+  unsigned* sq_flags_{nullptr};
+  unsigned* cq_head_{nullptr};
+  unsigned* cq_tail_{nullptr};
+  void* cqes_{nullptr};
+
+  // Entries queued since the last enter() are published by it
+  unsigned sqe_tail_{0};
+
+  // Linked timeouts, by entry, the kernel reads them when submitted
+  std::vector<kernel_timespec> timeouts_;
+
+  /**
+   * Makes room for the given number of entries
+   *
+   * Queued entries are submitted if the ring is too full.
+   */
+  void reserve(unsigned nb_sqes);
+
+  // Returns a cleared entry, room must have been reserved
+  void* next_sqe();
+
+  int submit(unsigned min_complete, unsigned flags, void const* argument);
+
+ public:
+  /**
+   * Sets up a ring of at least the given number of entries
+   *
+   * Throws if the kernel does not support io_uring, or lacks a
+   * feature boson needs (Linux 5.19).
+   */
+  explicit io_ring(unsigned nb_entries);
+  io_ring(io_ring const&) = delete;
+  io_ring(io_ring&&) = delete;
+  io_ring& operator=(io_ring const&) = delete;
+  io_ring& operator=(io_ring&&) = delete;
+  ~io_ring();
+
+  /**
+   * Queues an operation, its completion carries user_data
+   *
+   * If timeout is not null, the operation is cancelled when it
+   * expires. The linked timeout completes with timeout_user_data.
+   */
+  void queue_operation(io_operation const& operation, std::uint64_t user_data,
+                       timespec const* timeout, std::uint64_t timeout_user_data);
+
+  // Queues a one shot wait for the fd to be readable
+  void queue_poll(int fd, std::uint64_t user_data);
+
+  // Queues the cancellation of every operation on the fd
+  void queue_cancel(int fd, std::uint64_t user_data);
+
+  /**
+   * Tells if enter() has some work even without waiting
+   *
+   * This is the case for queued entries, or completions the kernel
+   * must be entered for.
+   */
+  bool needs_enter() const;
+
+  bool has_completions() const;
+
+  /**
+   * Submits the queued entries, then waits for a completion if asked
+   *
+   * A null timeout waits forever. Timeouts and signals only end the wait.
+   */
+  void enter(bool wait, timespec const* timeout);
+
+  /**
+   * Pops a completion, returns false if there is none
+   */
+  bool pop_completion(std::uint64_t& user_data, int& result);
+};
+
+}  // namespace boson
+
+#endif  // BOSON_IORING_H_
@@ -1,8 +1,11 @@
 #include "boson/net/socket.h"
+#include "boson/engine.h"
 #include "boson/exception.h"
+#include "boson/semaphore.h"
+#include <fcntl.h>
 #include <unistd.h>
 #include <arpa/inet.h>
-#include <sys/fcntl.h>
+#include <netinet/in.h>
 #include <unistd.h>
 #include <netdb.h>
 #include <cstring>
@@ -10,6 +13,13 @@
 namespace boson {
 namespace net {
 
+namespace {
+[[noreturn]] void close_and_throw(int sockfd, char const* message) {
+  ::close(sockfd);
+  throw boson::exception(message);
+}
+}  // namespace
+
 socket_t create_listening_socket(
     int port,
     int max_connections,
@@ -17,33 +27,112 @@ socket_t create_listening_socket(
     int type,
     int protocol,
     int non_block,
-    in_addr_t receive_from) {
+    in_addr_t receive_from,
+    bool reuse_port) {
 
-  sockaddr_in serv_addr;
-  int sockfd = ::socket(domain, type, protocol);
-  if (non_block) ::fcntl(sockfd, F_SETFL, O_NONBLOCK);
+  // Flags are set at creation, without a fcntl
+  int sockfd = ::socket(domain, type | SOCK_CLOEXEC | (non_block ? SOCK_NONBLOCK : 0), protocol);
   if (sockfd < 0) throw boson::exception("ERROR opening socket");
 
-  ::memset(&serv_addr, 0, sizeof(serv_addr));
-  serv_addr.sin_family = domain;
-  serv_addr.sin_addr.s_addr = receive_from;
-  serv_addr.sin_port = htons(port);
-
   // re use socket
   int yes = 1;
   if (::setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) == -1)
-    throw boson::exception("setsockopt");
+    close_and_throw(sockfd, "setsockopt");
+  if (reuse_port && ::setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) == -1)
+    close_and_throw(sockfd, "setsockopt");
 
   // bind it
-  if (::bind(sockfd, reinterpret_cast<sockaddr*>(&serv_addr), sizeof(serv_addr)) < 0)
-    throw boson::exception("ERROR on binding");
+  int bind_rc = -1;
+  if (AF_INET6 == domain) {
+    sockaddr_in6 serv_addr;
+    ::memset(&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin6_family = AF_INET6;
+    serv_addr.sin6_addr = in6addr_any;
+    serv_addr.sin6_port = htons(port);
+    bind_rc = ::bind(sockfd, reinterpret_cast<sockaddr*>(&serv_addr), sizeof(serv_addr));
+  }
+  else {
+    sockaddr_in serv_addr;
+    ::memset(&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin_family = domain;
+    serv_addr.sin_addr.s_addr = receive_from;
+    serv_addr.sin_port = htons(port);
+    bind_rc = ::bind(sockfd, reinterpret_cast<sockaddr*>(&serv_addr), sizeof(serv_addr));
+  }
+  if (bind_rc < 0)
+    close_and_throw(sockfd, "ERROR on binding");
 
   listen(sockfd, max_connections);
 
   return sockfd;
 }
 
-    
+namespace {
+// Forwards a stream to the write side of another socket, returns like proxy
+int forward(socket_t from, socket_t to, int timeout_ms) {
+  constexpr size_t chunk_size = 1 << 16;  // Default pipe capacity
+  int pipe_ends[2];
+  if (::pipe2(pipe_ends, O_NONBLOCK | O_CLOEXEC) < 0) return -1;
+  ssize_t nb_pending = 0;
+  ssize_t nb_moved = 0;
+  while (0 < (nb_moved = boson::splice(from, nullptr, pipe_ends[1], nullptr, chunk_size,
+                                       SPLICE_F_MOVE, timeout_ms))) {
+    nb_pending = nb_moved;
+    while (0 < nb_pending && 0 < (nb_moved = boson::splice(pipe_ends[0], nullptr, to, nullptr,
+                                                           nb_pending, SPLICE_F_MOVE,
+                                                           timeout_ms)))
+      nb_pending -= nb_moved;
+    if (0 < nb_pending) break;
+  }
+  int error = errno;
+  boson::close(pipe_ends[0]);
+  boson::close(pipe_ends[1]);
+  if (0 == nb_moved && 0 == nb_pending) {
+    ::shutdown(to, SHUT_WR);
+    return 0;
+  }
+  // Wakes up the other direction
+  ::shutdown(from, SHUT_RDWR);
+  ::shutdown(to, SHUT_RDWR);
+  errno = 0 == nb_moved ? EPIPE : error;
+  return -1;
+}
+}  // namespace
+
+int proxy(socket_t fd_a, socket_t fd_b, int timeout_ms) {
+  int b_to_a_result = 0;
+  int b_to_a_error = 0;
+  shared_semaphore done(0);
+  start_explicit(boson::internal::current_thread()->id(), [&]() {
+    b_to_a_result = forward(fd_b, fd_a, timeout_ms);
+    b_to_a_error = errno;
+    done.post();
+  });
+  int result = forward(fd_a, fd_b, timeout_ms);
+  int error = errno;
+  done.wait();
+  if (result < 0 || b_to_a_result < 0) {
+    errno = result < 0 ? error : b_to_a_error;
+    return -1;
+  }
+  return 0;
+}
+
+namespace internal {
+int bound_port(socket_t socket) {
+  sockaddr_storage address;
+  socklen_t length = sizeof(address);
+  if (::getsockname(socket, reinterpret_cast<sockaddr*>(&address), &length) < 0)
+    throw boson::exception("ERROR on getsockname");
+  return ntohs(AF_INET6 == address.ss_family
+                   ? reinterpret_cast<sockaddr_in6*>(&address)->sin6_port
+                   : reinterpret_cast<sockaddr_in*>(&address)->sin_port);
+}
+
+std::size_t nb_engine_threads() {
+  return boson::internal::current_thread()->get_engine().max_nb_cores();
+}
+}  // namespace internal
 
 }  // namespace net
 }  // namespace boson
@@ -0,0 +1,100 @@
+#include "boson/net/zerocopy.h"
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include "boson/exception.h"
+#include "boson/internal/thread.h"
+
+// Older C libraries lack them
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+namespace boson {
+namespace net {
+
+zerocopy_sender::zerocopy_sender(socket_t socket) : socket_{socket} {
+  int yes = 1;
+  if (::setsockopt(socket_, SOL_SOCKET, SO_ZEROCOPY, &yes, sizeof(yes)) < 0)
+    throw boson::exception(std::string("setsockopt SO_ZEROCOPY failed (") + ::strerror(errno) +
+                           ")");
+}
+
+void zerocopy_sender::release(std::uint32_t first_id, std::uint32_t last_id) {
+  early_ranges_.emplace_back(first_id, last_id);
+  // Ranges following the released ones extend them
+  for (std::size_t index = 0; index < early_ranges_.size();) {
+    auto range = early_ranges_[index];
+    if (0 < static_cast<std::int32_t>(range.first - released_id_)) {
+      ++index;
+      continue;
+    }
+    if (0 <= static_cast<std::int32_t>(range.second - released_id_))
+      released_id_ = range.second + 1;
+    early_ranges_[index] = early_ranges_.back();
+    early_ranges_.pop_back();
+    index = 0;
+  }
+}
+
+int zerocopy_sender::read_completions() {
+  int nb_completions = 0;
+  while (true) {
+    char control[CMSG_SPACE(sizeof(sock_extended_err))];
+    msghdr message{};
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    // The error queue never blocks
+    if (::recvmsg(socket_, &message, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+      return (EAGAIN == errno || EWOULDBLOCK == errno) ? nb_completions : -1;
+    for (cmsghdr* header = CMSG_FIRSTHDR(&message); header;
+         header = CMSG_NXTHDR(&message, header)) {
+      if (!((SOL_IP == header->cmsg_level && IP_RECVERR == header->cmsg_type) ||
+            (SOL_IPV6 == header->cmsg_level && IPV6_RECVERR == header->cmsg_type)))
+        continue;
+      sock_extended_err error;
+      std::memcpy(&error, CMSG_DATA(header), sizeof(error));
+      if (SO_EE_ORIGIN_ZEROCOPY != error.ee_origin) continue;
+      // Sends from ee_info to ee_data
+      release(error.ee_info, error.ee_data);
+      if (error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+        nb_copied_ += error.ee_data - error.ee_info + 1;
+      ++nb_completions;
+    }
+  }
+}
+
+ssize_t zerocopy_sender::send(void const* buffer, size_t length, int flags, int timeout_ms) {
+  // Completions must wake up this thread's waiters, not interrupt them
+  internal::current_thread()->watch_error_queue(socket_);
+  ssize_t nb_sent = boson::send(socket_, buffer, length, flags | MSG_ZEROCOPY, timeout_ms);
+  // The kernel only counts sends which sent something
+  if (0 < nb_sent) ++next_id_;
+  return nb_sent;
+}
+
+int zerocopy_sender::wait(std::uint32_t id, int timeout_ms) {
+  if (0 <= static_cast<std::int32_t>(id - next_id_)) {
+    errno = EINVAL;
+    return -1;
+  }
+  internal::current_thread()->watch_error_queue(socket_);
+  while (!released(id)) {
+    int nb_completions = read_completions();
+    if (nb_completions < 0) return -1;
+    if (0 < nb_completions) continue;
+    // Completions come with EPOLLERR, which wakes up writers
+    internal::current_thread()->consume_readiness(socket_, false);
+    if (wait_readiness<false>(socket_, timeout_ms) < 0) return -1;
+  }
+  return 0;
+}
+
+}  // namespace net
+}  // namespace boson
@@ -0,0 +1,48 @@
+#include "boson/placement.h"
+#include <random>
+#include "boson/engine.h"
+
+namespace boson {
+
+std::size_t thread_loads::size() const {
+  return engine_ ? engine_->max_nb_cores() : loads_.size();
+}
+
+thread_load thread_loads::operator[](thread_id id) const {
+  return engine_ ? engine_->threads_[id]->thread.load() : loads_[id];
+}
+
+thread_id round_robin_placement::place(thread_loads const& loads) {
+  return next_thread_.fetch_add(1, std::memory_order_relaxed) % loads.size();
+}
+
+least_loaded_placement::least_loaded_placement(load_weights weights) : weights_{weights} {
+}
+
+thread_id least_loaded_placement::place(thread_loads const& loads) {
+  thread_id best_thread = 0;
+  std::size_t best_score = weights_.score(loads[0]);
+  for (thread_id id = 1; id < loads.size() && 0 < best_score; ++id) {
+    std::size_t score = weights_.score(loads[id]);
+    if (score < best_score) {
+      best_score = score;
+      best_thread = id;
+    }
+  }
+  return best_thread;
+}
+
+power_of_two_choices_placement::power_of_two_choices_placement(load_weights weights)
+    : weights_{weights} {
+}
+
+thread_id power_of_two_choices_placement::place(thread_loads const& loads) {
+  thread_local std::minstd_rand generator{std::random_device{}()};
+  std::size_t nb_threads = loads.size();
+  if (nb_threads < 2) return 0;
+  thread_id first = generator() % nb_threads;
+  thread_id second = (first + 1 + generator() % (nb_threads - 1)) % nb_threads;
+  return weights_.score(loads[second]) < weights_.score(loads[first]) ? second : first;
+}
+
+}  // namespace boson
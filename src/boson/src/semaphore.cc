@@ -24,10 +24,11 @@ bool semaphore::pop_a_waiter(internal::thread* current) {
     waiting_unit_t waiter;
     if (read(waiter)) {
       thread* managing_thread = waiter.first;
-      managing_thread->push_command(
-          current->id(), std::make_unique<thread_command>(
-                             thread_command_type::schedule_waiting_routine,
-                             std::make_pair(this->shared_from_this(),waiter.second)));
+      thread_command* wake_command =
+          current->engine_proxy_.new_command(thread_command_type::schedule_waiting_routine);
+      wake_command->waiting_semaphore = this->shared_from_this();
+      wake_command->slot_index = waiter.second;
+      managing_thread->push_command(current->id(), wake_command);
       return true;
     }
   }
@@ -53,13 +54,14 @@ void semaphore::disable() {
   using namespace internal;
   counter_.store(disabled_standpoint, std::memory_order_release);
   waiting_unit_t waiter;
-  auto current_thread_id = current_thread()->id();
+  thread* current = current_thread();
   while (read(waiter)) {
     thread* managing_thread = waiter.first;
-    managing_thread->push_command(
-        current_thread_id,
-        std::make_unique<thread_command>(thread_command_type::schedule_waiting_routine,
-                                         std::make_pair(this->shared_from_this(), waiter.second)));
+    thread_command* wake_command =
+        current->engine_proxy_.new_command(thread_command_type::schedule_waiting_routine);
+    wake_command->waiting_semaphore = this->shared_from_this();
+    wake_command->slot_index = waiter.second;
+    managing_thread->push_command(current->id(), wake_command);
   }
 }
 
@@ -80,7 +82,7 @@ semaphore_result semaphore::wait(int timeout) {
     current_routine->add_semaphore_wait(this);
     if (0 <= timeout) {
       current_routine->add_timer(
-          time_point_cast<milliseconds>(high_resolution_clock::now() + milliseconds(timeout)));
+          time_point_cast<microseconds>(this_thread->now() + milliseconds(timeout)));
     }
     current_routine->commit_event_round();
     happened_type = current_routine->happened_type_;
@@ -3,6 +3,9 @@
 #include "boson/internal/routine.h"
 #include "boson/internal/thread.h"
 #include "boson/syscall_traits.h"
+#include <poll.h>
+#include <algorithm>
+#include <climits>
 
 namespace boson {
 
@@ -12,28 +15,36 @@ void yield() {
   thread* this_thread = current_thread();
   routine* current_routine = this_thread->running_routine();
   current_routine->status_ = routine_status::yielding;
-  this_thread->context() = jump_fcontext(this_thread->context().fctx, nullptr);
+  transfer_t scheduler_context = jump_fcontext(this_thread->context().fctx, nullptr);
+  // A yielding routine may be resumed by another thread, so the TLS must be read again
+  current_thread()->context() = scheduler_context;
   current_routine->previous_status_ = routine_status::yielding;
   current_routine->status_ = routine_status::running;
 }
 
-void sleep(std::chrono::milliseconds duration) {
-  // Compute the time in ms
+void sleep(std::chrono::microseconds duration) {
   using namespace std::chrono;
   thread* this_thread = current_thread();
   routine* current_routine = this_thread->running_routine();
   current_routine->start_event_round();
   current_routine->add_timer(
-      time_point_cast<milliseconds>(high_resolution_clock::now() + duration));
+      time_point_cast<microseconds>(this_thread->now() + duration));
   current_routine->commit_event_round();
   current_routine->previous_status_ = routine_status::wait_events;
   current_routine->status_ = routine_status::running;
 }
 
+std::chrono::high_resolution_clock::time_point now() {
+  thread* this_thread = current_thread();
+  return this_thread ? this_thread->now() : std::chrono::high_resolution_clock::now();
+}
+
 template <bool IsARead>
 int wait_readiness(fd_t fd, int timeout_ms) {
   using namespace std::chrono;
   thread* this_thread = current_thread();
+  // An edge came since the last time the fd would block, no need to wait
+  if (this_thread->consume_readiness(fd, IsARead)) return 0;
   routine* current_routine = this_thread->running_routine();
   current_routine->start_event_round();
   //add_event<IsARead>::apply(current_routine, fd);
@@ -43,7 +54,7 @@ int wait_readiness(fd_t fd, int timeout_ms) {
     current_routine->add_write(fd);
   //add_event<IsARead>::apply(current_routine, fd);
   if (0 <= timeout_ms) {
-    current_routine->add_timer(time_point_cast<milliseconds>(high_resolution_clock::now() + milliseconds(timeout_ms)));
+    current_routine->add_timer(time_point_cast<microseconds>(this_thread->now() + milliseconds(timeout_ms)));
   }
   current_routine->commit_event_round();
   current_routine->previous_status_ = routine_status::wait_events;
@@ -57,11 +68,64 @@ int wait_readiness(fd_t fd, int timeout_ms) {
   return return_code;
 }
 
+template int wait_readiness<true>(fd_t fd, int timeout_ms);
+template int wait_readiness<false>(fd_t fd, int timeout_ms);
+
+event_status submit_operation(io_operation const& operation, int timeout_ms) {
+  routine* current_routine = current_thread()->running_routine();
+  current_routine->start_event_round();
+  current_routine->add_operation(operation, timeout_ms);
+  current_routine->commit_event_round();
+  current_routine->previous_status_ = routine_status::wait_events;
+  current_routine->status_ = routine_status::running;
+  return current_routine->happened_status();
+}
+
+event_status submit_file_operation(file_operation const& operation) {
+  routine* current_routine = current_thread()->running_routine();
+  current_routine->start_event_round();
+  current_routine->add_file_operation(operation);
+  current_routine->commit_event_round();
+  current_routine->previous_status_ = routine_status::wait_events;
+  current_routine->status_ = routine_status::running;
+  return current_routine->happened_status();
+}
+
+/**
+ * Submits the io_uring equivalent of a syscall
+ *
+ * Syscalls without one, or whose arguments it cannot carry, return
+ * -EAGAIN and wait for the readiness of their fd instead.
+ */
+template <int SyscallId, class... Args>
+inline auto submit_syscall(int fd, int timeout_ms, Args&&... args)
+    -> decltype(syscall_traits<SyscallId>::operation(fd, args...), event_status{}) {
+  return submit_operation(syscall_traits<SyscallId>::operation(fd, args...), timeout_ms);
+}
+
+template <int SyscallId>
+inline event_status submit_syscall(...) {
+  return -EAGAIN;
+}
+
 template <int SyscallId> struct boson_classic_syscall {
   template <class... Args>
   static inline decltype(auto) call(int fd, int timeout_ms, Args&&... args) {
     auto return_code = syscall_callable<SyscallId>::call(fd, std::forward<Args>(args)...);
-    if (return_code < 0 && (EAGAIN == errno || EWOULDBLOCK == errno)) {
+    // With io_uring, the kernel does the syscall again once the fd is ready
+    if (return_code < 0 && (EAGAIN == errno || EWOULDBLOCK == errno) &&
+        current_thread()->uses_io_uring()) {
+      event_status status = submit_syscall<SyscallId>(fd, timeout_ms, args...);
+      if (-EAGAIN != status) {
+        if (status < 0) errno = -status;
+        return status < 0 ? -1L : static_cast<long>(status);
+      }
+    }
+    // Being woken up does not guarantee the syscall succeeds, another routine may have
+    // consumed the data first. The timeout applies to each wait.
+    while (return_code < 0 && (EAGAIN == errno || EWOULDBLOCK == errno)) {
+      // Edges seen before the syscall are outdated
+      current_thread()->consume_readiness(fd, syscall_traits<SyscallId>::is_read);
       return_code = wait_readiness<syscall_traits<SyscallId>::is_read>(fd, timeout_ms);
       if (0 == return_code) {
         return_code = syscall_callable<SyscallId>::call(fd, std::forward<Args>(args)...);
@@ -83,6 +147,11 @@ socket_t accept(socket_t socket, sockaddr* address, socklen_t* address_len, int
   return boson_classic_syscall<SYS_accept>::call(socket, timeout_ms, address, address_len);
 }
 
+socket_t accept4(socket_t socket, sockaddr* address, socklen_t* address_len, int flags,
+                 int timeout_ms) {
+  return boson_classic_syscall<SYS_accept4>::call(socket, timeout_ms, address, address_len, flags);
+}
+
 ssize_t send(socket_t socket, const void* buffer, size_t length, int flags, int timeout_ms) {
   return boson_classic_syscall<SYS_sendto>::call(socket, timeout_ms, buffer, length, flags, nullptr, 0);
 }
@@ -91,6 +160,141 @@ ssize_t recv(socket_t socket, void* buffer, size_t length, int flags, int timeou
   return boson_classic_syscall<SYS_recvfrom>::call(socket, timeout_ms, buffer, length, flags, nullptr, 0);
 }
 
+ssize_t sendto(socket_t socket, const void* buffer, size_t length, int flags,
+               sockaddr const* address, socklen_t address_len, int timeout_ms) {
+  return boson_classic_syscall<SYS_sendto>::call(socket, timeout_ms, buffer, length, flags, address,
+                                                 address_len);
+}
+
+ssize_t recvfrom(socket_t socket, void* buffer, size_t length, int flags, sockaddr* address,
+                 socklen_t* address_len, int timeout_ms) {
+  return boson_classic_syscall<SYS_recvfrom>::call(socket, timeout_ms, buffer, length, flags,
+                                                   address, address_len);
+}
+
+int sendmmsg(socket_t socket, mmsghdr* messages, unsigned int nb_messages, int flags,
+             int timeout_ms) {
+  return boson_classic_syscall<SYS_sendmmsg>::call(socket, timeout_ms, messages, nb_messages,
+                                                   flags);
+}
+
+int recvmmsg(socket_t socket, mmsghdr* messages, unsigned int nb_messages, int flags,
+             int timeout_ms) {
+  return boson_classic_syscall<SYS_recvmmsg>::call(socket, timeout_ms, messages, nb_messages,
+                                                   flags, nullptr);
+}
+
+ssize_t readv(fd_t fd, iovec const* buffers, int nb_buffers, int timeout_ms) {
+  return boson_classic_syscall<SYS_readv>::call(fd, timeout_ms, buffers, nb_buffers);
+}
+
+ssize_t writev(fd_t fd, iovec const* buffers, int nb_buffers, int timeout_ms) {
+  return boson_classic_syscall<SYS_writev>::call(fd, timeout_ms, buffers, nb_buffers);
+}
+
+ssize_t sendmsg(socket_t socket, msghdr const* message, int flags, int timeout_ms) {
+  return boson_classic_syscall<SYS_sendmsg>::call(socket, timeout_ms, message, flags);
+}
+
+ssize_t recvmsg(socket_t socket, msghdr* message, int flags, int timeout_ms) {
+  return boson_classic_syscall<SYS_recvmsg>::call(socket, timeout_ms, message, flags);
+}
+
+ssize_t sendfile(socket_t out_fd, fd_t in_fd, off_t* offset, size_t count, int timeout_ms) {
+  return boson_classic_syscall<SYS_sendfile>::call(out_fd, timeout_ms, in_fd, offset, count);
+}
+
+namespace {
+/**
+ * Waits for the end of a fd to fd transfer which would block
+ *
+ * The syscall does not tell which end it is, poll does.
+ */
+int wait_transfer(fd_t fd_in, fd_t fd_out, int timeout_ms) {
+  pollfd ends[2] = {{fd_in, POLLIN, 0}, {fd_out, POLLOUT, 0}};
+  if (::poll(ends, 2, 0) < 0) return -1;
+  if (0 == ends[0].revents) {
+    current_thread()->consume_readiness(fd_in, true);
+    return wait_readiness<true>(fd_in, timeout_ms);
+  }
+  if (0 == ends[1].revents) {
+    current_thread()->consume_readiness(fd_out, false);
+    return wait_readiness<false>(fd_out, timeout_ms);
+  }
+  // Both got ready since the syscall
+  yield();
+  return 0;
+}
+}  // namespace
+
+ssize_t splice(fd_t fd_in, loff_t* off_in, fd_t fd_out, loff_t* off_out, size_t length,
+               unsigned int flags, int timeout_ms) {
+  flags |= SPLICE_F_NONBLOCK;
+  ssize_t return_code =
+      syscall_callable<SYS_splice>::call(fd_in, off_in, fd_out, off_out, length, flags);
+  while (return_code < 0 && (EAGAIN == errno || EWOULDBLOCK == errno)) {
+    if (wait_transfer(fd_in, fd_out, timeout_ms) < 0) return -1;
+    return_code = syscall_callable<SYS_splice>::call(fd_in, off_in, fd_out, off_out, length, flags);
+  }
+  return return_code;
+}
+
+ssize_t tee(fd_t fd_in, fd_t fd_out, size_t length, unsigned int flags, int timeout_ms) {
+  flags |= SPLICE_F_NONBLOCK;
+  ssize_t return_code = syscall_callable<SYS_tee>::call(fd_in, fd_out, length, flags);
+  while (return_code < 0 && (EAGAIN == errno || EWOULDBLOCK == errno)) {
+    if (wait_transfer(fd_in, fd_out, timeout_ms) < 0) return -1;
+    return_code = syscall_callable<SYS_tee>::call(fd_in, fd_out, length, flags);
+  }
+  return return_code;
+}
+
+int advance_buffers(iovec*& buffers, int nb_buffers, std::size_t nb_bytes) {
+  while (0 < nb_buffers && buffers->iov_len <= nb_bytes) {
+    nb_bytes -= buffers->iov_len;
+    ++buffers;
+    --nb_buffers;
+  }
+  if (0 < nb_buffers) {
+    buffers->iov_base = static_cast<char*>(buffers->iov_base) + nb_bytes;
+    buffers->iov_len -= nb_bytes;
+  }
+  return nb_buffers;
+}
+
+ssize_t writev_all(fd_t fd, iovec* buffers, int nb_buffers, int timeout_ms) {
+  ssize_t total = 0;
+  // Empty buffers are skipped first, so that a zero byte write means nothing is left
+  nb_buffers = advance_buffers(buffers, nb_buffers, 0);
+  while (0 < nb_buffers) {
+    ssize_t nb_written = writev(fd, buffers, std::min(nb_buffers, IOV_MAX), timeout_ms);
+    if (nb_written < 0) return -1;
+    total += nb_written;
+    nb_buffers = advance_buffers(buffers, nb_buffers, nb_written);
+  }
+  return total;
+}
+
+ssize_t sendmsg_all(socket_t socket, msghdr* message, int flags, int timeout_ms) {
+  ssize_t total = 0;
+  iovec* buffers = message->msg_iov;
+  int nb_buffers = advance_buffers(buffers, static_cast<int>(message->msg_iovlen), 0);
+  while (0 < nb_buffers || 0 < message->msg_controllen) {
+    message->msg_iov = buffers;
+    message->msg_iovlen = std::min(nb_buffers, IOV_MAX);
+    ssize_t nb_sent = sendmsg(socket, message, flags, timeout_ms);
+    if (nb_sent < 0) return -1;
+    total += nb_sent;
+    nb_buffers = advance_buffers(buffers, nb_buffers, nb_sent);
+    // Ancillary data went with the first part
+    message->msg_control = nullptr;
+    message->msg_controllen = 0;
+  }
+  message->msg_iov = buffers;
+  message->msg_iovlen = 0;
+  return total;
+}
+
 /**
  * Connect system call
  *
@@ -101,6 +305,7 @@ ssize_t recv(socket_t socket, void* buffer, size_t length, int flags, int timeou
 int connect(socket_t sockfd, const sockaddr* addr, socklen_t addrlen, int timeout_ms) {
   int return_code = syscall_callable<SYS_connect>::call(sockfd, addr, addrlen);
   if (return_code < 0 && errno == EINPROGRESS) {
+    current_thread()->consume_readiness(sockfd, syscall_traits<SYS_connect>::is_read);
     return_code = wait_readiness<syscall_traits<SYS_connect>::is_read>(sockfd, timeout_ms);
     if (0 == return_code) {
       socklen_t optlen = sizeof(return_code);
@@ -116,6 +321,8 @@ int connect(socket_t sockfd, const sockaddr* addr, socklen_t addrlen, int timeou
 }
 
 int close(fd_t fd) {
+  // Before the close, so that no thread can see the reused number with the old generation
+  current_thread()->engine_proxy_.notify_fd_closed(fd);
   int rc = syscall_callable<SYS_close>::call(fd);
   auto current_errno = errno;
   current_thread()->unregister_fd(fd);
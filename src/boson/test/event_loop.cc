@@ -3,6 +3,7 @@
 #include <unistd.h>
 #include <cstdio>
 #include <thread>
+#include <vector>
 #include <cstring>
 #include "boson/exception.h"
 #include "boson/system.h"
@@ -34,6 +35,10 @@ struct handler01 : public event_handler {
     last_data = data;
     last_status = status;
   }
+  void completion(void* data, event_status status) override {
+    last_data = data;
+    last_status = status;
+  }
 };
 
 TEST_CASE("Event Loop - Event notification", "[eventloop][notif]") {
@@ -52,6 +57,37 @@ TEST_CASE("Event Loop - Event notification", "[eventloop][notif]") {
   CHECK(handler_instance.last_status == 0);
 }
 
+TEST_CASE("Event Loop - Many event notifications", "[eventloop][notif]") {
+  struct handler02 : public handler01 {
+    std::vector<int> ids;
+    void event(int event_id, void* data, event_status status) override {
+      ids.push_back(event_id);
+    }
+  } handler_instance;
+
+  boson::event_loop loop(handler_instance,1);
+  std::vector<int> event_ids;
+  for (int index = 0; index < 200; ++index)
+    event_ids.push_back(loop.register_event(nullptr));
+
+  // Notifications of the same event are merged until dispatched
+  loop.send_event(event_ids[3]);
+  loop.send_event(event_ids[3]);
+  loop.send_event(event_ids[150]);
+  loop.send_event(event_ids[199]);
+  loop.unregister_event(event_ids[199]);
+  loop.loop(1, 0);
+  REQUIRE(handler_instance.ids.size() == 2u);
+  CHECK(handler_instance.ids[0] == event_ids[3]);
+  CHECK(handler_instance.ids[1] == event_ids[150]);
+
+  // Unregistered ids are reused
+  CHECK(loop.register_event(nullptr) == event_ids[199]);
+  handler_instance.ids.clear();
+  loop.loop(1, 0);
+  CHECK(handler_instance.ids.empty());
+}
+
 TEST_CASE("Event Loop - FD Read/Write", "[eventloop][read/write]") {
   handler01 handler_instance;
   int pipe_fds[2];
@@ -111,6 +147,66 @@ TEST_CASE("Event Loop - FD Read/Write same FD", "[eventloop][read/write]") {
 #endif
 }
 
+TEST_CASE("Event Loop - Any number of ready fds", "[eventloop][read/write]") {
+  struct handler02 : public handler01 {
+    int nb_reads{0};
+    void read(int fd, void* data, event_status status) override {
+      ++nb_reads;
+    }
+  };
+
+  // Event counts equal to errno values are not errors
+  for (int nb_fds : {4, 9, 14, 22}) {
+    handler02 handler_instance;
+    boson::event_loop loop(handler_instance,1);
+    std::vector<int> pipe_fds(2 * nb_fds);
+    for (int index = 0; index < nb_fds; ++index) {
+      REQUIRE(0 == ::pipe2(&pipe_fds[2 * index], O_NONBLOCK));
+      loop.register_read(pipe_fds[2 * index], nullptr);
+      size_t data{1};
+      ::write(pipe_fds[2 * index + 1], &data, sizeof(size_t));
+    }
+    CHECK(loop.loop(1) == loop_end_reason::max_iter_reached);
+    CHECK(handler_instance.nb_reads == nb_fds);
+    for (int fd : pipe_fds) ::close(fd);
+  }
+}
+
+TEST_CASE("Event Loop - Readiness cache", "[eventloop][read/write]") {
+  handler01 handler_instance;
+  int pipe_fds[2];
+  ::pipe(pipe_fds);
+  ::fcntl(pipe_fds[0], F_SETFL, ::fcntl(pipe_fds[0], F_GETFD) | O_NONBLOCK);
+
+  boson::event_loop loop(handler_instance,1);
+  loop.watch(pipe_fds[0], 0);
+  int event_read = loop.register_read(pipe_fds[0], nullptr);
+  loop.unregister(event_read);
+
+  // Nobody waits for the edge, it is kept
+  size_t data{1};
+  ::write(pipe_fds[1], &data, sizeof(size_t));
+  loop.loop(1);
+  CHECK(handler_instance.last_read_fd == -1);
+  CHECK(loop.consume_readiness(pipe_fds[0], true));
+  CHECK(!loop.consume_readiness(pipe_fds[0], true));
+
+  // Waiting again does not touch the epoll table
+  std::size_t nb_registrations = loop.nb_fd_registrations();
+  loop.register_read(pipe_fds[0], nullptr);
+  ::write(pipe_fds[1], &data, sizeof(size_t));
+  loop.loop(1);
+  CHECK(handler_instance.last_read_fd == pipe_fds[0]);
+  CHECK(loop.nb_fd_registrations() == nb_registrations);
+
+  // A new generation means a new file behind the fd number
+  loop.watch(pipe_fds[0], 1);
+  CHECK(loop.nb_fd_registrations() == nb_registrations + 1);
+
+  ::close(pipe_fds[0]);
+  ::close(pipe_fds[1]);
+}
+
 TEST_CASE("Event Loop - FD Panic Read/Write", "[eventloop][panic]") {
   handler01 handler_instance;
   int pipe_fds[2];
@@ -147,3 +243,65 @@ TEST_CASE("Event Loop - Bas fds", "[eventloop]") {
   ::close(disk_fd);
   ::unlink(temp1.c_str());
 }
+
+TEST_CASE("Event Loop - Precise timeout", "[eventloop][timeout]") {
+  using namespace std::chrono;
+  handler01 handler_instance;
+  boson::event_loop loop(handler_instance,1);
+
+  auto start = steady_clock::now();
+  auto return_code = loop.loop(1, microseconds(1500));
+  auto elapsed = steady_clock::now() - start;
+  CHECK(return_code == loop_end_reason::timed_out);
+  CHECK(microseconds(1500) <= elapsed);
+}
+
+TEST_CASE("Event Loop - io_uring operations", "[eventloop][io_uring]") {
+  handler01 handler_instance;
+  int pipe_fds[2];
+  ::pipe(pipe_fds);
+  ::fcntl(pipe_fds[0], F_SETFL, ::fcntl(pipe_fds[0], F_GETFD) | O_NONBLOCK);
+
+  boson::event_loop loop(handler_instance,1);
+  if (!loop.enable_io_uring()) {
+    WARN("io_uring is not supported by this kernel");
+    return;
+  }
+
+  // Operations wait for the fd themselves
+  size_t data{0};
+  int tag = 0;
+  loop.submit({io_operation_type::read, pipe_fds[0], &data, sizeof(data)}, &tag, -1);
+  loop.loop(1,0);
+  CHECK(handler_instance.last_data == nullptr);
+  size_t sent{42};
+  ::write(pipe_fds[1], &sent, sizeof(size_t));
+  loop.loop(1);
+  CHECK(handler_instance.last_data == &tag);
+  CHECK(handler_instance.last_status == sizeof(size_t));
+  CHECK(data == 42);
+  CHECK(loop.nb_io_operations() == 1);
+
+  // Timeouts and interruptions cancel them
+  handler_instance.last_data = nullptr;
+  loop.submit({io_operation_type::read, pipe_fds[0], &data, sizeof(data)}, &tag, 1);
+  loop.loop(1);
+  CHECK(handler_instance.last_data == &tag);
+  CHECK(handler_instance.last_status == -ETIMEDOUT);
+
+  handler_instance.last_data = nullptr;
+  loop.submit({io_operation_type::read, pipe_fds[0], &data, sizeof(data)}, &tag, -1);
+  loop.loop(1,0);
+  loop.send_fd_panic(0,pipe_fds[0]);
+  while (!handler_instance.last_data) loop.loop(1);
+  CHECK(handler_instance.last_status == -EINTR);
+
+  // Event fds still work, through epoll
+  int event_id = loop.register_event(nullptr);
+  loop.send_event(event_id);
+  loop.loop(1);
+  CHECK(handler_instance.last_id == event_id);
+
+  ::close(pipe_fds[0]);
+  ::close(pipe_fds[1]);
+}
@@ -0,0 +1,91 @@
+#include "catch.hpp"
+#include "boson/boson.h"
+#include "boson/file.h"
+#include "boson/semaphore.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace boson;
+
+TEST_CASE("File - Asynchronous file syscalls", "[syscalls][file]") {
+  constexpr int nb_blocks = 32;
+  constexpr std::size_t block_size = 4096;
+  char path[] = "/tmp/boson_file_XXXXXX";
+  int temporary = ::mkstemp(path);
+  REQUIRE(0 <= temporary);
+  ::close(temporary);
+
+  for (auto backend : {event_backend::epoll, event_backend::io_uring}) {
+    ::truncate(path, 0);
+    std::vector<int> matches(nb_blocks, 0);
+    int fsync_result = -1;
+    off_t file_size = 0;
+    int open_errno = 0;
+    int pread_errno = 0;
+    int stat_errno = 0;
+    engine_statistics statistics, burst_start, burst_end;
+    {
+      boson::engine instance(2);
+      instance.set_event_backend(backend);
+      instance.set_max_file_workers(2);
+      instance.start([&]() {
+        int fd = file::open(path, O_RDWR);
+        // REQUIRE would throw through the routine context switch
+        CHECK(0 <= fd);
+        if (fd < 0) return;
+
+        // Blocks are written and read back concurrently, from both threads
+        burst_start = internal::current_thread()->get_engine().statistics();
+        shared_semaphore done(0);
+        for (int index = 0; index < nb_blocks; ++index) {
+          start([&, index, done]() mutable {
+            std::string block(block_size, static_cast<char>('a' + index % 26));
+            std::string read_back(block_size, '\0');
+            off_t offset = index * block_size;
+            if (static_cast<ssize_t>(block_size) ==
+                    file::pwrite(fd, block.data(), block_size, offset) &&
+                static_cast<ssize_t>(block_size) ==
+                    file::pread(fd, &read_back[0], block_size, offset))
+              matches[index] = block == read_back;
+            done.post();
+          });
+        }
+        for (int index = 0; index < nb_blocks; ++index) done.wait();
+        burst_end = internal::current_thread()->get_engine().statistics();
+
+        fsync_result = file::fsync(fd);
+        struct stat status;
+        if (0 == file::stat(path, &status)) file_size = status.st_size;
+        boson::close(fd);
+
+        char buffer[16];
+        if (file::open("/nonexistent/boson", O_RDONLY) < 0) open_errno = errno;
+        if (file::pread(fd, buffer, sizeof(buffer), 0) < 0) pread_errno = errno;
+        if (file::stat("/nonexistent/boson", &status) < 0) stat_errno = errno;
+        statistics = internal::current_thread()->get_engine().statistics();
+      });
+    }
+    for (int index = 0; index < nb_blocks; ++index) CHECK(1 == matches[index]);
+    CHECK(0 == fsync_result);
+    CHECK(static_cast<off_t>(nb_blocks * block_size) == file_size);
+    CHECK(ENOENT == open_errno);
+    CHECK(EBADF == pread_errno);
+    CHECK(ENOENT == stat_errno);
+    if (event_backend::epoll == backend) {
+      // Every syscall went to the workers
+      CHECK(static_cast<std::size_t>(nb_blocks * 2 + 6) == statistics.nb_file_operations);
+      // Results of concurrent syscalls come back in batches
+      std::size_t nb_operations = burst_end.nb_file_operations - burst_start.nb_file_operations;
+      std::size_t nb_batches = burst_end.nb_file_batches - burst_start.nb_file_batches;
+      CHECK(static_cast<std::size_t>(nb_blocks * 2) == nb_operations);
+      CHECK(nb_batches < nb_operations);
+    }
+  }
+
+  ::unlink(path);
+}
@@ -0,0 +1,41 @@
+#include <memory>
+#include <string>
+#include "boson/memory/small_vector.h"
+#include "catch.hpp"
+
+TEST_CASE("Small vector - Spill over", "[memory][small_vector]") {
+  auto token = std::make_shared<int>(0);
+  {
+    boson::memory::small_vector<std::shared_ptr<int>, 2> instance;
+    CHECK(instance.empty());
+    instance.emplace_back(token);
+    instance.emplace_back(token);
+    CHECK(instance.capacity() == 2);
+    CHECK(token.use_count() == 3);
+
+    // Elements move to the heap
+    instance.emplace_back(token);
+    CHECK(instance.size() == 3);
+    CHECK(2 < instance.capacity());
+    CHECK(token.use_count() == 4);
+    for (auto& value : instance) CHECK(value == token);
+
+    // The heap storage is kept for the next fill
+    std::size_t capacity = instance.capacity();
+    instance.clear();
+    CHECK(instance.empty());
+    CHECK(token.use_count() == 1);
+    instance.emplace_back(token);
+    CHECK(instance.capacity() == capacity);
+    CHECK(instance.back() == token);
+  }
+  CHECK(token.use_count() == 1);
+}
+
+TEST_CASE("Small vector - Order", "[memory][small_vector]") {
+  boson::memory::small_vector<std::string, 4> instance;
+  for (int index = 0; index < 100; ++index) instance.emplace_back(std::to_string(index));
+  bool ordered = true;
+  for (int index = 0; index < 100; ++index) ordered &= instance[index] == std::to_string(index);
+  CHECK(ordered);
+}
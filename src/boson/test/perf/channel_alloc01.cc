@@ -0,0 +1,65 @@
+/**
+ * Allocations per channel operation
+ *
+ * Two routines in different threads play ping pong through channels,
+ * so every operation wakes up a routine of the other thread. Heap
+ * allocations are counted once the exchange is warmed up.
+ */
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include "boson/boson.h"
+#include "boson/channel.h"
+
+static constexpr size_t nb_warmup = 1e3;
+static constexpr size_t nb_iter = 1e5;
+
+namespace {
+std::atomic<size_t> nb_allocations{0};
+}
+
+void* operator new(std::size_t size) {
+  nb_allocations.fetch_add(1, std::memory_order_relaxed);
+  void* result = std::malloc(size);
+  if (!result) throw std::bad_alloc();
+  return result;
+}
+
+void operator delete(void* pointer) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+
+int main(void) {
+  using namespace boson;
+  size_t nb_measured = 0;
+  boson::run(2, [&nb_measured]() {
+    channel<int, 1> ping;
+    channel<int, 1> pong;
+    start_explicit(1, [](auto in, auto out) -> void {
+      int value = 0;
+      for (size_t index = 0; index < nb_warmup + nb_iter; ++index) {
+        in >> value;
+        out << value;
+      }
+    }, ping, pong);
+    start_explicit(0, [&nb_measured](auto out, auto in) -> void {
+      int value = 0;
+      size_t nb_before = 0;
+      for (size_t index = 0; index < nb_warmup + nb_iter; ++index) {
+        if (index == nb_warmup) nb_before = nb_allocations.load(std::memory_order_relaxed);
+        out << 1;
+        in >> value;
+      }
+      nb_measured = nb_allocations.load(std::memory_order_relaxed) - nb_before;
+    }, ping, pong);
+  });
+  // Each iteration is two writes and two reads
+  std::cout << "Allocations per channel operation: "
+            << static_cast<double>(nb_measured) / (4 * nb_iter) << "\n";
+  return 0;
+}
@@ -0,0 +1,106 @@
+/**
+ * Datagram ingestion, one syscall per datagram or per batch
+ *
+ * A sender pushes bursts of small datagrams over UDP loopback with
+ * sendmmsg, the receiver reads them either with recv or with recvmmsg.
+ * This measures the cost of draining a datagram on the receiving side.
+ */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include "boson/boson.h"
+#include "boson/syscalls.h"
+
+static constexpr size_t nb_bursts = 1e4;
+static constexpr size_t burst_size = 32;
+
+static void run(char const* name, size_t batch_size) {
+  using namespace std::chrono;
+  // Unix datagram sockets queue few datagrams, UDP bursts fit in the socket buffer
+  int sockets[2];
+  sockaddr_in addresses[2];
+  for (int index = 0; index < 2; ++index) {
+    sockets[index] = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    addresses[index] = sockaddr_in{};
+    addresses[index].sin_family = AF_INET;
+    addresses[index].sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t address_len = sizeof(addresses[index]);
+    auto address = reinterpret_cast<sockaddr*>(&addresses[index]);
+    if (sockets[index] < 0 || ::bind(sockets[index], address, sizeof(addresses[index])) < 0 ||
+        ::getsockname(sockets[index], address, &address_len) < 0)
+      return;
+  }
+  for (int index = 0; index < 2; ++index) {
+    if (::connect(sockets[index], reinterpret_cast<sockaddr*>(&addresses[1 - index]),
+                  sizeof(addresses[1 - index])) < 0)
+      return;
+  }
+  double elapsed = 0;
+  {
+    boson::engine instance(1);
+    instance.start([&]() {
+      // Sender, waits for a burst to be read before sending the next one
+      boson::start([](int fd) {
+        std::uint64_t values[burst_size] = {};
+        iovec buffers[burst_size];
+        mmsghdr messages[burst_size];
+        for (size_t index = 0; index < burst_size; ++index) {
+          buffers[index] = {&values[index], sizeof(values[index])};
+          messages[index] = mmsghdr{};
+          messages[index].msg_hdr.msg_iov = &buffers[index];
+          messages[index].msg_hdr.msg_iovlen = 1;
+        }
+        for (size_t burst = 0; burst < nb_bursts; ++burst) {
+          boson::sendmmsg(fd, messages, burst_size, 0);
+          std::uint64_t ack = 0;
+          boson::recv(fd, &ack, sizeof(ack), 0);
+        }
+      }, sockets[0]);
+
+      // Receiver
+      boson::start([&](int fd) {
+        std::uint64_t values[burst_size];
+        iovec buffers[burst_size];
+        mmsghdr messages[burst_size];
+        for (size_t index = 0; index < burst_size; ++index) {
+          buffers[index] = {&values[index], sizeof(values[index])};
+          messages[index] = mmsghdr{};
+          messages[index].msg_hdr.msg_iov = &buffers[index];
+          messages[index].msg_hdr.msg_iovlen = 1;
+        }
+        for (size_t burst = 0; burst < nb_bursts; ++burst) {
+          // Only the draining of a burst is timed, not the wait for it
+          if (boson::recv(fd, &values[0], sizeof(values[0]), MSG_PEEK) <= 0) return;
+          auto start = high_resolution_clock::now();
+          size_t nb_received = 0;
+          while (nb_received < burst_size) {
+            int nb_messages =
+                1 < batch_size
+                    ? boson::recvmmsg(fd, messages, burst_size - nb_received, 0)
+                    : static_cast<int>(0 < boson::recv(fd, &values[0], sizeof(values[0]), 0));
+            if (nb_messages <= 0) return;
+            nb_received += nb_messages;
+          }
+          elapsed +=
+              duration_cast<duration<double, std::nano>>(high_resolution_clock::now() - start)
+                  .count();
+          std::uint64_t ack = 0;
+          boson::send(fd, &ack, sizeof(ack), 0);
+        }
+      }, sockets[1]);
+    });
+  }
+  ::close(sockets[0]);
+  ::close(sockets[1]);
+  std::cout << name << ": " << elapsed / (nb_bursts * burst_size) << " ns per datagram\n";
+}
+
+int main(void) {
+  run("recv", 1);
+  run("recvmmsg", burst_size);
+  return 0;
+}
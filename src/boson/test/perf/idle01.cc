@@ -0,0 +1,57 @@
+/**
+ * Idle routine footprint
+ *
+ * Many routines are blocked on a semaphore, like idle connections of a
+ * server. This measures the memory they use, for each stack size class.
+ */
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "boson/boson.h"
+#include "boson/semaphore.h"
+
+static constexpr size_t nb_routines = 1e5;
+
+namespace {
+struct memory_usage {
+  double mapped;
+  double resident;
+};
+
+memory_usage memory_bytes() {
+  size_t mapped = 0, resident = 0;
+  std::ifstream statm("/proc/self/statm");
+  statm >> mapped >> resident;
+  double page_size = ::sysconf(_SC_PAGESIZE);
+  return {mapped * page_size, resident * page_size};
+}
+
+void measure(std::string const& name, boson::stack_size size) {
+  memory_usage before = memory_bytes();
+  memory_usage during{};
+  boson::run(1, [&]() {
+    boson::shared_semaphore idle(0);
+    size_t nb_started = 0;
+    for (size_t index = 0; index < nb_routines; ++index) {
+      boson::start(size, [idle, &nb_started]() mutable {
+        ++nb_started;
+        idle.wait();
+      });
+    }
+    while (nb_started < nb_routines) boson::yield();
+    during = memory_bytes();
+    for (size_t index = 0; index < nb_routines; ++index) idle.post();
+  });
+  std::cout << name << ": " << (during.mapped - before.mapped) / nb_routines << " mapped, "
+            << (during.resident - before.resident) / nb_routines
+            << " resident bytes per idle routine\n";
+}
+}
+
+int main(void) {
+  measure("Small ", boson::stack_size::small);
+  measure("Medium", boson::stack_size::medium);
+  measure("Large ", boson::stack_size::large);
+  return 0;
+}
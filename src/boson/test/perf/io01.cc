@@ -0,0 +1,72 @@
+/**
+ * Pipelined requests over a socket
+ *
+ * A client sends batches of requests to an echo server which yields
+ * between each of them, like a proxy doing some work, so requests often
+ * arrive while the server is not waiting for them. This measures the
+ * cost of a request and the fd registrations it needs, with each event
+ * backend.
+ */
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include "boson/boson.h"
+
+static constexpr size_t nb_batches = 1e5;
+static constexpr size_t batch_size = 4;
+
+static void run(char const* name, boson::event_backend backend) {
+  using namespace std::chrono;
+  int sockets[2];
+  if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sockets) < 0) return;
+  double elapsed = 0;
+  boson::engine_statistics statistics;
+  {
+    boson::engine instance(1);
+    instance.set_event_backend(backend);
+    instance.start([&]() {
+      // Server
+      boson::start([](int fd) {
+        std::uint64_t request = 0;
+        for (size_t index = 0; index < nb_batches * batch_size; ++index) {
+          boson::read(fd, &request, sizeof(request));
+          boson::yield();
+          boson::write(fd, &request, sizeof(request));
+        }
+      }, sockets[1]);
+
+      // Client
+      boson::start([&](int fd) {
+        auto start = high_resolution_clock::now();
+        std::uint64_t reply = 0;
+        for (size_t batch = 0; batch < nb_batches; ++batch) {
+          for (std::uint64_t index = 0; index < batch_size; ++index) {
+            boson::write(fd, &index, sizeof(index));
+            boson::yield();
+          }
+          for (size_t index = 0; index < batch_size; ++index)
+            boson::read(fd, &reply, sizeof(reply));
+        }
+        elapsed = duration_cast<duration<double, std::nano>>(high_resolution_clock::now() - start)
+                      .count();
+        statistics = instance.statistics();
+      }, sockets[0]);
+    });
+  }
+  ::close(sockets[0]);
+  ::close(sockets[1]);
+  size_t nb_requests = nb_batches * batch_size;
+  std::cout << name << ": " << elapsed / nb_requests << " ns, "
+            << static_cast<double>(statistics.nb_fd_registrations) / nb_requests
+            << " fd registrations and "
+            << static_cast<double>(statistics.nb_io_operations) / nb_requests
+            << " io_uring operations per request\n";
+}
+
+int main(void) {
+  run("epoll", boson::event_backend::epoll);
+  run("io_uring", boson::event_backend::io_uring);
+  return 0;
+}
@@ -0,0 +1,81 @@
+/**
+ * Skewed spawn latency
+ *
+ * One thread is kept busy by pinned routines while short routines are
+ * spawned without an explicit thread. This measures the delay between
+ * the spawn of a short routine and its first execution, for each
+ * placement policy.
+ */
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "boson/boson.h"
+
+static constexpr size_t nb_threads = 4;
+static constexpr size_t nb_busy_routines = 16;
+static constexpr size_t nb_busy_iter = 2e6;
+static constexpr size_t nb_spawned = 2e4;
+static constexpr size_t yield_period = 1e4;
+static constexpr boson::thread_id busy_thread = 0;
+static constexpr boson::thread_id spawner_thread = 1;
+
+namespace {
+using namespace std::chrono;
+using time_point_t = high_resolution_clock::time_point;
+
+volatile size_t sink = 0;
+
+void busy() {
+  size_t accumulator = 0;
+  for (size_t index = 0; index < nb_busy_iter; ++index) {
+    accumulator += index * index;
+    if (index % yield_period == 0) boson::yield();
+  }
+  sink += accumulator;
+}
+
+void report(std::string const& name, std::vector<double>& latencies) {
+  std::sort(begin(latencies), end(latencies));
+  auto percentile = [&latencies](double ratio) {
+    return latencies[std::min(latencies.size() - 1, static_cast<size_t>(ratio * latencies.size()))];
+  };
+  std::cout << name << ": p50 " << percentile(0.5) << " us, p99 " << percentile(0.99)
+            << " us, p999 " << percentile(0.999) << " us, max " << latencies.back() << " us\n";
+}
+
+void measure(std::string const& name, std::unique_ptr<boson::placement_policy> policy) {
+  std::vector<time_point_t> spawned(nb_spawned);
+  std::vector<double> latencies(nb_spawned);
+  {
+    boson::engine instance(nb_threads);
+    instance.set_placement_policy(std::move(policy));
+    // One thread gets all the busy routines
+    for (size_t index = 0; index < nb_busy_routines; ++index) instance.start(busy_thread, busy);
+    instance.start(spawner_thread, [&spawned, &latencies]() {
+      for (size_t index = 0; index < nb_spawned; ++index) {
+        spawned[index] = high_resolution_clock::now();
+        boson::start(
+            [&spawned, &latencies](size_t index) {
+              latencies[index] =
+                  duration_cast<duration<double, std::micro>>(high_resolution_clock::now() -
+                                                              spawned[index])
+                      .count();
+            },
+            index);
+        if (index % 100 == 0) boson::yield();
+      }
+    });
+  }
+  report(name, latencies);
+}
+}
+
+int main(void) {
+  measure("Round robin         ", std::make_unique<boson::round_robin_placement>());
+  measure("Least loaded        ", std::make_unique<boson::least_loaded_placement>());
+  measure("Power of two choices", std::make_unique<boson::power_of_two_choices_placement>());
+  return 0;
+}
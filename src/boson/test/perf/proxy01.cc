@@ -0,0 +1,87 @@
+/**
+ * Proxying a stream, copying it in user space or splicing it
+ *
+ * A client streams data to a sink through a proxy routine, which either
+ * reads and writes each chunk or uses net::proxy. This measures the
+ * throughput of the proxy.
+ */
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include "boson/boson.h"
+#include "boson/net/socket.h"
+
+static constexpr size_t nb_chunks = 1 << 12;
+static constexpr size_t chunk_size = 1 << 16;
+
+// Copies a stream through a user space buffer
+static void copy(int from, int to) {
+  std::vector<char> buffer(chunk_size);
+  ssize_t nb_read = 0;
+  while (0 < (nb_read = boson::read(from, buffer.data(), buffer.size()))) {
+    for (ssize_t offset = 0; offset < nb_read;) {
+      ssize_t nb_written = boson::write(to, buffer.data() + offset, nb_read - offset);
+      if (nb_written <= 0) return;
+      offset += nb_written;
+    }
+  }
+  ::shutdown(to, SHUT_WR);
+}
+
+static void run(char const* name, bool splices) {
+  using namespace std::chrono;
+  int client[2];
+  int sink[2];
+  if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, client) < 0 ||
+      ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sink) < 0)
+    return;
+  double elapsed = 0;
+  {
+    boson::engine instance(1);
+    instance.start([&]() {
+      // Proxy
+      boson::start([&]() {
+        if (splices)
+          boson::net::proxy(client[1], sink[0]);
+        else
+          copy(client[1], sink[0]);
+      });
+
+      // Client
+      boson::start([&]() {
+        std::vector<char> chunk(chunk_size, 'p');
+        for (size_t index = 0; index < nb_chunks; ++index) {
+          for (size_t offset = 0; offset < chunk.size();) {
+            ssize_t nb_written = boson::write(client[0], chunk.data() + offset,
+                                              chunk.size() - offset);
+            if (nb_written <= 0) return;
+            offset += nb_written;
+          }
+        }
+        ::shutdown(client[0], SHUT_WR);
+      });
+
+      // Sink
+      boson::start([&]() {
+        auto start = high_resolution_clock::now();
+        std::vector<char> buffer(chunk_size);
+        while (0 < boson::read(sink[1], buffer.data(), buffer.size()))
+          ;
+        elapsed = duration_cast<duration<double>>(high_resolution_clock::now() - start).count();
+        // Ends the other direction of the proxy
+        ::shutdown(sink[1], SHUT_WR);
+        ::shutdown(client[0], SHUT_RD);
+      });
+    });
+  }
+  for (int fd : {client[0], client[1], sink[0], sink[1]}) ::close(fd);
+  std::cout << name << ": " << nb_chunks * chunk_size / elapsed / (1 << 20) << " MiB/s\n";
+}
+
+int main(void) {
+  run("copy", false);
+  run("splice", true);
+  return 0;
+}
@@ -0,0 +1,65 @@
+/**
+ * Request latency between two threads
+ *
+ * A client and a server run on their own thread and exchange a request
+ * over a socket, one at a time, so both threads run out of routines
+ * after each message. This measures the round trip and the CPU it
+ * costs, for several busy poll budgets.
+ */
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <iostream>
+#include "boson/boson.h"
+
+static constexpr size_t nb_requests = 1e4;
+
+static void run(std::chrono::microseconds budget) {
+  using namespace std::chrono;
+  int sockets[2];
+  if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sockets) < 0) return;
+  double elapsed = 0;
+  boson::engine_statistics statistics;
+  std::clock_t cpu_start = std::clock();
+  {
+    boson::engine instance(2);
+    instance.set_busy_poll(budget);
+    // Server
+    instance.start(boson::thread_id{1}, [](int fd) {
+      std::uint64_t request = 0;
+      for (size_t index = 0; index < nb_requests; ++index) {
+        boson::read(fd, &request, sizeof(request));
+        boson::write(fd, &request, sizeof(request));
+      }
+    }, sockets[1]);
+
+    // Client
+    instance.start(boson::thread_id{0}, [&](int fd) {
+      auto start = high_resolution_clock::now();
+      std::uint64_t reply = 0;
+      for (std::uint64_t index = 0; index < nb_requests; ++index) {
+        boson::write(fd, &index, sizeof(index));
+        boson::read(fd, &reply, sizeof(reply));
+      }
+      elapsed = duration_cast<duration<double, std::nano>>(high_resolution_clock::now() - start)
+                    .count();
+      statistics = instance.statistics();
+    }, sockets[0]);
+  }
+  double cpu = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC * 1e9;
+  ::close(sockets[0]);
+  ::close(sockets[1]);
+  std::cout << "Busy poll " << budget.count() << "us: " << elapsed / nb_requests << " ns, "
+            << cpu / nb_requests << " ns of CPU per request, " << statistics.nb_busy_poll_hits
+            << " hits, " << statistics.nb_busy_poll_misses << " misses\n";
+}
+
+int main(void) {
+  using namespace std::chrono;
+  run(microseconds(0));
+  run(microseconds(20));
+  run(microseconds(200));
+  return 0;
+}
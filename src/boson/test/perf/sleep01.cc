@@ -0,0 +1,40 @@
+/**
+ * Sleep precision
+ *
+ * A routine sleeps for short durations in a loop. This measures how
+ * late it wakes up on average, for each timer resolution.
+ */
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "boson/boson.h"
+
+static constexpr size_t nb_sleeps = 1e3;
+
+namespace {
+using namespace std::chrono;
+
+void measure(std::string const& name, boson::timer_resolution resolution,
+             microseconds sleep_duration) {
+  high_resolution_clock::duration elapsed{};
+  {
+    boson::engine instance(1);
+    instance.set_timer_resolution(resolution);
+    instance.start([&elapsed, sleep_duration]() {
+      auto start = high_resolution_clock::now();
+      for (size_t index = 0; index < nb_sleeps; ++index) boson::sleep(sleep_duration);
+      elapsed = high_resolution_clock::now() - start;
+    });
+  }
+  double late = duration_cast<duration<double, std::micro>>(elapsed).count() / nb_sleeps -
+                sleep_duration.count();
+  std::cout << name << " sleep(" << sleep_duration.count() << "us): " << late << " us late\n";
+}
+}
+
+int main(void) {
+  measure("Milliseconds", boson::timer_resolution::milliseconds, microseconds(1000));
+  measure("Microseconds", boson::timer_resolution::microseconds, microseconds(1000));
+  measure("Microseconds", boson::timer_resolution::microseconds, microseconds(250));
+  return 0;
+}
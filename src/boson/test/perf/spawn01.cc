@@ -0,0 +1,45 @@
+/**
+ * Spawn throughput
+ *
+ * Every thread runs a routine spawning many short lived ones, like a
+ * server starting a routine per connection.
+ */
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include "boson/boson.h"
+
+static constexpr size_t nb_threads = 4;
+static constexpr size_t nb_spawned_per_thread = 2e5;
+
+namespace {
+std::atomic<size_t> nb_finished{0};
+}
+
+int main(void) {
+  using namespace std::chrono;
+  auto start = high_resolution_clock::now();
+  boson::engine_statistics statistics;
+  boson::run(nb_threads, [&statistics]() {
+    for (boson::thread_id id = 0; id < nb_threads; ++id) {
+      boson::start_explicit(id, []() {
+        for (size_t index = 0; index < nb_spawned_per_thread; ++index) {
+          boson::start([]() -> void { nb_finished.fetch_add(1, std::memory_order_relaxed); });
+          if (index % 100 == 0) boson::yield();
+        }
+      });
+    }
+    while (nb_finished.load(std::memory_order_relaxed) < nb_threads * nb_spawned_per_thread)
+      boson::yield();
+    statistics = boson::internal::current_thread()->get_engine().statistics();
+  });
+  double elapsed =
+      duration_cast<duration<double, std::milli>>(high_resolution_clock::now() - start).count();
+  std::cout << nb_finished.load() << " routines in " << elapsed << " ms ("
+            << nb_finished.load() / elapsed * 1e3 << " routines/s)\n";
+  std::cout << "Wake ups sent: " << statistics.nb_wakeups_sent
+            << ", saved: " << statistics.nb_wakeups_saved << "\n";
+  std::cout << "Stacks mapped: " << statistics.nb_stacks_mapped
+            << ", reused: " << statistics.nb_stacks_reused << "\n";
+  return 0;
+}
@@ -0,0 +1,65 @@
+/**
+ * Spawn allocations
+ *
+ * A routine spawns many small lambdas, and the heap allocations made
+ * once the pools are warm are counted by replacing the global operator
+ * new. Small routines should not allocate at all.
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include "boson/boson.h"
+
+static constexpr size_t nb_warm_up = 1e4;
+static constexpr size_t nb_spawned = 1e6;
+static constexpr size_t yield_period = 100;
+
+namespace {
+std::atomic<size_t> nb_allocations{0};
+}
+
+void* operator new(std::size_t size) {
+  nb_allocations.fetch_add(1, std::memory_order_relaxed);
+  void* pointer = std::malloc(size);
+  if (!pointer) throw std::bad_alloc();
+  return pointer;
+}
+
+void operator delete(void* pointer) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+
+namespace {
+void spawn(size_t nb_routines, size_t& sum) {
+  for (size_t index = 0; index < nb_routines; ++index) {
+    boson::start([&sum](size_t value) { sum += value; }, index);
+    if (index % yield_period == 0) boson::yield();
+  }
+  boson::yield();
+}
+}
+
+int main(void) {
+  using namespace std::chrono;
+  size_t allocations = 0;
+  double elapsed = 0;
+  boson::run(1, [&]() {
+    size_t sum = 0;
+    spawn(nb_warm_up, sum);
+    size_t allocations_before = nb_allocations.load();
+    auto start = high_resolution_clock::now();
+    spawn(nb_spawned, sum);
+    elapsed = duration_cast<duration<double, std::nano>>(high_resolution_clock::now() - start)
+                  .count();
+    allocations = nb_allocations.load() - allocations_before;
+  });
+  std::cout << static_cast<double>(allocations) / nb_spawned << " allocations and "
+            << elapsed / nb_spawned << " ns per spawn\n";
+  return 0;
+}
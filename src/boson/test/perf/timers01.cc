@@ -0,0 +1,45 @@
+/**
+ * Timer churn
+ *
+ * Many routines of a single thread wait on a semaphore with a long
+ * timeout, and are woken up well before it. Every wait arms a timer
+ * which is canceled right after, while a background of sleeping
+ * routines keeps the timer set populated.
+ */
+#include <chrono>
+#include <iostream>
+#include "boson/boson.h"
+#include "boson/semaphore.h"
+
+static constexpr size_t nb_sleepers = 1e4;
+static constexpr size_t nb_waiters = 100;
+static constexpr size_t nb_iter = 1e4;
+static constexpr int wait_timeout_ms = 1e4;
+
+int main(void) {
+  using namespace std::chrono;
+  double elapsed = 0;
+  boson::run(1, [&elapsed]() {
+    // Background timers, spread over several levels of the wheel
+    for (size_t index = 0; index < nb_sleepers; ++index) {
+      boson::start([](size_t index) { boson::sleep(milliseconds(100 + index % 1000)); }, index);
+    }
+    auto start = high_resolution_clock::now();
+    boson::shared_semaphore sema(0);
+    for (size_t index = 0; index < nb_waiters; ++index) {
+      boson::start([sema]() mutable {
+        for (size_t iter = 0; iter < nb_iter; ++iter) sema.wait(wait_timeout_ms);
+      });
+    }
+    boson::start([sema, start, &elapsed]() mutable {
+      for (size_t iter = 0; iter < nb_waiters * nb_iter; ++iter) {
+        sema.post();
+        boson::yield();
+      }
+      elapsed = duration_cast<duration<double, std::nano>>(high_resolution_clock::now() - start)
+                    .count();
+    });
+  });
+  std::cout << elapsed / (nb_waiters * nb_iter) << " ns per timed wait\n";
+  return 0;
+}
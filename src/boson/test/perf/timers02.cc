@@ -0,0 +1,102 @@
+/**
+ * Read timeouts of many connections
+ *
+ * 100k connections each wait for a read with a 30s timeout. Reads keep
+ * completing before their timeout, each one cancels its timer and arms
+ * the next one, like a busy server. Compares the timing wheel with the
+ * std::map of dates it replaced, where a date holds its timers and
+ * their number still active.
+ */
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+#include "boson/internal/timing_wheel.h"
+
+namespace {
+constexpr std::size_t nb_connections = 1e5;
+constexpr std::size_t nb_reads = 1e7;
+constexpr std::uint64_t read_timeout_us = 30e6;
+constexpr std::size_t advance_period = 100;  // Reads per scheduler iteration
+
+using tick_t = std::uint64_t;
+
+struct timed_set {
+  std::vector<std::size_t> slots;
+  std::size_t nb_active = 0;
+};
+
+// Order in which connections get data
+std::vector<std::size_t> make_reads() {
+  std::mt19937_64 generator(42);
+  std::uniform_int_distribution<std::size_t> connection(0, nb_connections - 1);
+  std::vector<std::size_t> reads(nb_reads);
+  for (auto& read : reads) read = connection(generator);
+  return reads;
+}
+
+template <class Function>
+double time_per_read(Function&& function) {
+  using namespace std::chrono;
+  auto start = high_resolution_clock::now();
+  function();
+  return duration_cast<duration<double, std::nano>>(high_resolution_clock::now() - start).count() /
+         nb_reads;
+}
+}  // namespace
+
+int main(void) {
+  auto reads = make_reads();
+  std::size_t nb_expired = 0;
+
+  double wheel = time_per_read([&]() {
+    boson::internal::timing_wheel timers(0);
+    std::vector<boson::internal::timing_wheel::handle_t> handles(nb_connections);
+    tick_t now = 0;
+    for (std::size_t index = 0; index < nb_connections; ++index)
+      handles[index] = timers.insert(now + read_timeout_us + index, index);
+    for (std::size_t index = 0; index < nb_reads; ++index) {
+      now = index;  // One read per microsecond
+      std::size_t connection = reads[index];
+      timers.cancel(handles[connection]);
+      handles[connection] = timers.insert(now + read_timeout_us, connection);
+      if (0 == index % advance_period)
+        timers.advance(now, [&nb_expired](std::size_t) { ++nb_expired; });
+    }
+  });
+
+  double map = time_per_read([&]() {
+    std::map<tick_t, timed_set> timers;
+    std::vector<tick_t> deadlines(nb_connections);
+    tick_t now = 0;
+    for (std::size_t index = 0; index < nb_connections; ++index) {
+      deadlines[index] = now + read_timeout_us + index;
+      auto& set = timers[deadlines[index]];
+      set.slots.push_back(index);
+      ++set.nb_active;
+    }
+    for (std::size_t index = 0; index < nb_reads; ++index) {
+      now = index;
+      std::size_t connection = reads[index];
+      auto canceled = timers.find(deadlines[connection]);
+      if (0 == --canceled->second.nb_active) timers.erase(canceled);
+      deadlines[connection] = now + read_timeout_us;
+      auto& set = timers[deadlines[connection]];
+      set.slots.push_back(connection);
+      ++set.nb_active;
+      if (0 == index % advance_period) {
+        while (!timers.empty() && timers.begin()->first <= now) {
+          nb_expired += timers.begin()->second.nb_active;
+          timers.erase(timers.begin());
+        }
+      }
+    }
+  });
+
+  std::cout << nb_connections << " pending read timeouts\n"
+            << "timing wheel: " << wheel << " ns per read\n"
+            << "std::map:     " << map << " ns per read\n";
+  return 0;
+}
@@ -0,0 +1,53 @@
+/**
+ * Imbalanced CPU load
+ *
+ * Every heavy routine is placed on the same thread. Pinned routines
+ * cannot be stolen, so this compares the completion time with and
+ * without work stealing.
+ */
+#include <chrono>
+#include <iostream>
+#include "boson/boson.h"
+
+static constexpr size_t nb_threads = 4;
+static constexpr size_t nb_routines = 400;
+static constexpr size_t nb_light_iter = 1e3;
+static constexpr size_t nb_heavy_iter = 1e6;
+static constexpr size_t yield_period = 1e3;
+
+namespace {
+volatile size_t sink = 0;
+
+void work(size_t nb_iter) {
+  size_t accumulator = 0;
+  for (size_t index = 0; index < nb_iter; ++index) {
+    accumulator += index * index;
+    if (index % yield_period == 0) boson::yield();
+  }
+  sink += accumulator;
+}
+
+template <class Starter>
+double measure(Starter&& starter) {
+  using namespace std::chrono;
+  auto start = high_resolution_clock::now();
+  boson::run(nb_threads, [&starter]() {
+    for (size_t index = 0; index < nb_routines; ++index) {
+      // Heavy routines all land on the same thread
+      starter(index % nb_threads, (index % nb_threads == 0) ? nb_heavy_iter : nb_light_iter);
+    }
+  });
+  return duration_cast<duration<double, std::milli>>(high_resolution_clock::now() - start)
+      .count();
+}
+}
+
+int main(void) {
+  double pinned = measure([](size_t thread, size_t nb_iter) {
+    boson::start_explicit(thread, work, nb_iter);
+  });
+  double stealable = measure([](size_t, size_t nb_iter) { boson::start(work, nb_iter); });
+  std::cout << "Pinned (no stealing): " << pinned << " ms\n";
+  std::cout << "Work stealing:        " << stealable << " ms\n";
+  return 0;
+}
@@ -0,0 +1,29 @@
+/**
+ * Yield cost
+ *
+ * Pinned routines yield in a loop, so every context switch goes
+ * through the local run queue.
+ */
+#include <chrono>
+#include <iostream>
+#include "boson/boson.h"
+
+static constexpr size_t nb_threads = 1;
+static constexpr size_t nb_routines = 100;
+static constexpr size_t nb_yields = 1e5;
+
+int main(void) {
+  using namespace std::chrono;
+  auto start = high_resolution_clock::now();
+  boson::run(nb_threads, []() {
+    for (size_t index = 0; index < nb_routines; ++index) {
+      boson::start_explicit(0, []() {
+        for (size_t yields = 0; yields < nb_yields; ++yields) boson::yield();
+      });
+    }
+  });
+  double elapsed =
+      duration_cast<duration<double, std::nano>>(high_resolution_clock::now() - start).count();
+  std::cout << elapsed / (nb_routines * nb_yields) << " ns per yield\n";
+  return 0;
+}
@@ -0,0 +1,68 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "boson/queues/chase_lev.h"
+#include "catch.hpp"
+
+TEST_CASE("Queues - Chase-Lev - serial behavior", "[queues][chase_lev]") {
+  boson::queues::chase_lev<int> queue(2);
+  int value = 0;
+  CHECK(!queue.pop(value));
+  CHECK(!queue.steal(value));
+
+  // Grows past the initial capacity
+  for (int index = 0; index < 10; ++index) queue.push(index);
+  CHECK(queue.size() == 10);
+
+  // Top is FIFO, bottom is LIFO
+  CHECK(queue.steal(value));
+  CHECK(value == 0);
+  CHECK(queue.pop(value));
+  CHECK(value == 9);
+  CHECK(queue.size() == 8);
+
+  for (int index = 1; index < 9; ++index) {
+    CHECK(queue.steal(value));
+    CHECK(value == index);
+  }
+  CHECK(queue.empty());
+  CHECK(!queue.pop(value));
+  CHECK(!queue.steal(value));
+}
+
+TEST_CASE("Queues - Chase-Lev - concurrent thieves", "[queues][chase_lev]") {
+  constexpr std::size_t const nb_thieves = 4;
+  constexpr std::size_t const sample_size = 1e5;
+
+  boson::queues::chase_lev<std::size_t> queue;
+  std::vector<std::atomic<int>> consumed(sample_size);
+  for (auto& counter : consumed) counter = 0;
+  std::atomic<bool> done{false};
+
+  std::vector<std::thread> thieves;
+  for (std::size_t index = 0; index < nb_thieves; ++index) {
+    thieves.emplace_back([&]() {
+      std::size_t value = 0;
+      while (!done.load() || !queue.empty()) {
+        if (queue.steal(value))
+          ++consumed[value];
+        else
+          std::this_thread::yield();
+      }
+    });
+  }
+
+  // The owner pushes and pops concurrently with thieves
+  std::size_t value = 0;
+  for (std::size_t index = 0; index < sample_size; ++index) {
+    queue.push(index);
+    if (index % 3 == 0 && queue.pop(value)) ++consumed[value];
+  }
+  while (queue.pop(value)) ++consumed[value];
+  done = true;
+  for (auto& thief : thieves) thief.join();
+
+  bool all_consumed_once = true;
+  for (auto& counter : consumed) all_consumed_once = all_consumed_once && (1 == counter.load());
+  CHECK(all_consumed_once);
+}
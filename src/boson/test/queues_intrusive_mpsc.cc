@@ -0,0 +1,81 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "boson/memory/node_pool.h"
+#include "boson/queues/intrusive_mpsc.h"
+#include "catch.hpp"
+
+namespace {
+struct node {
+  std::atomic<node*> next{nullptr};
+  boson::memory::node_pool<node>* pool = nullptr;
+  std::size_t producer = 0;
+  std::size_t value = 0;
+};
+}
+
+TEST_CASE("Queues - Intrusive MPSC - serial behavior", "[queues][intrusive_mpsc]") {
+  boson::queues::intrusive_mpsc<node> queue;
+  node first, second;
+  first.value = 1;
+  second.value = 2;
+  CHECK(nullptr == queue.read());
+  queue.write(&first);
+  queue.write(&second);
+  CHECK(&first == queue.read());
+  CHECK(&second == queue.read());
+  CHECK(nullptr == queue.read());
+  queue.write(&first);
+  CHECK(&first == queue.read());
+  CHECK(nullptr == queue.read());
+}
+
+TEST_CASE("Queues - Intrusive MPSC - pooled nodes", "[queues][intrusive_mpsc][node_pool]") {
+  constexpr std::size_t nb_producers = 4;
+  constexpr std::size_t nb_iter = 1e4;
+  constexpr std::size_t max_in_flight = 16;
+
+  boson::queues::intrusive_mpsc<node> queue;
+  std::vector<std::thread> producers;
+  std::vector<std::size_t> capacities(nb_producers);
+  std::atomic<std::size_t> in_flight[nb_producers];
+  for (auto& counter : in_flight) counter = 0;
+
+  for (std::size_t producer = 0; producer < nb_producers; ++producer) {
+    producers.emplace_back([&, producer]() {
+      boson::memory::node_pool<node> pool;
+      for (std::size_t index = 1; index <= nb_iter; ++index) {
+        // Bound the number of nodes in flight, so they must be recycled
+        while (max_in_flight <= in_flight[producer].load()) std::this_thread::yield();
+        ++in_flight[producer];
+        node* new_node = pool.allocate();
+        new_node->producer = producer;
+        new_node->value = index;
+        queue.write(new_node);
+      }
+      // Wait for the consumer to be done with our nodes
+      while (0 < in_flight[producer].load()) std::this_thread::yield();
+      capacities[producer] = pool.capacity();
+    });
+  }
+
+  std::size_t sum = 0;
+  std::size_t nb_read = 0;
+  while (nb_read < nb_producers * nb_iter) {
+    node* read_node = queue.read();
+    if (read_node) {
+      sum += read_node->value;
+      ++nb_read;
+      std::size_t producer = read_node->producer;
+      boson::memory::node_pool<node>::release(read_node);
+      --in_flight[producer];
+    } else {
+      // A preempted producer may hold the next node, let it run
+      std::this_thread::yield();
+    }
+  }
+  for (auto& thread : producers) thread.join();
+  CHECK(sum == nb_producers * nb_iter * (nb_iter + 1) / 2);
+  // Nodes were recycled instead of allocated
+  for (auto capacity : capacities) CHECK(capacity < nb_iter / 100);
+}
@@ -0,0 +1,33 @@
+#include "boson/queues/ring_buffer.h"
+#include "catch.hpp"
+
+TEST_CASE("Queues - Ring buffer", "[queues][ring_buffer]") {
+  boson::queues::ring_buffer<int> queue(2);
+  CHECK(queue.empty());
+
+  // Wrap around before growing
+  queue.push_back(0);
+  queue.push_back(1);
+  queue.pop_front();
+  queue.push_back(2);
+  CHECK(queue.capacity() == 2);
+  CHECK(queue.front() == 1);
+
+  // Growth keeps the order
+  for (int index = 3; index < 10; ++index) queue.push_back(index);
+  CHECK(queue.size() == 9);
+  for (int index = 1; index < 10; ++index) {
+    CHECK(queue.front() == index);
+    queue.pop_front();
+  }
+  CHECK(queue.empty());
+
+  // Swap exchanges contents and memory
+  boson::queues::ring_buffer<int> other(2);
+  other.push_back(42);
+  std::size_t capacity = queue.capacity();
+  queue.swap(other);
+  CHECK(queue.front() == 42);
+  CHECK(other.empty());
+  CHECK(other.capacity() == capacity);
+}
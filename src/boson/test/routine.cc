@@ -1,7 +1,17 @@
 #include "catch.hpp"
 #include "boson/boson.h"
+#include <sys/wait.h>
 #include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <csignal>
 #include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
 #include "boson/logger.h"
 #include "boson/semaphore.h"
 #include "boson/select.h"
@@ -10,6 +20,31 @@ using namespace boson;
 using namespace std::literals;
 
 namespace {
+struct light_routine {
+  void operator()() const {
+  }
+};
+
+struct heavy_routine {
+  void operator()() const {
+    volatile char buffer[10 * 1024];
+    buffer[0] = 1;
+  }
+};
+
+// Places every routine on the first thread
+struct first_thread_placement : public placement_policy {
+  thread_id place(thread_loads const&) override {
+    return 0;
+  }
+};
+
+int overflow_depth(int depth) {
+  volatile char frame[1024];
+  frame[0] = static_cast<char>(depth);
+  return 0 < depth ? overflow_depth(depth + 1) + frame[0] : 0;
+}
+
 inline int time_factor() {
 #ifdef BOSON_USE_VALGRIND
   return RUNNING_ON_VALGRIND ? 10 : 1;
@@ -44,3 +79,331 @@ TEST_CASE("Routines - Panic", "[routines][panic]") {
   });
 
 }
+
+TEST_CASE("Routines - Work stealing", "[routines][stealing]") {
+  constexpr int nb_routines = 100;
+  constexpr int nb_yields = 10;
+
+  SECTION("Yielding routines") {
+    std::atomic<int> nb_finished{0};
+    std::atomic<int> nb_stolen_runs{0};
+    {
+      engine instance(3);
+      // Every routine starts on thread 0, only stealing moves them
+      instance.set_placement_policy(std::make_unique<first_thread_placement>());
+      instance.start([&]() {
+        for (int index = 0; index < nb_routines; ++index) {
+          start([&]() {
+            for (int yields = 0; yields < nb_yields; ++yields) {
+              // Busy long enough for a woken up sibling to get a core
+              auto end = std::chrono::steady_clock::now() + 50us;
+              while (std::chrono::steady_clock::now() < end) {
+              }
+              boson::yield();
+              if (0 != internal::current_thread()->id())
+                ++nb_stolen_runs;
+            }
+            ++nb_finished;
+          });
+        }
+      });
+    }
+    CHECK(nb_finished == nb_routines);
+    CHECK(0 < nb_stolen_runs);
+  }
+
+  SECTION("Pinned routines stay in their thread") {
+    std::atomic<int> nb_migrations{0};
+    boson::run(3, [&]() {
+      for (int index = 0; index < nb_routines; ++index) {
+        start_explicit(1, [&]() {
+          for (int yields = 0; yields < nb_yields; ++yields) {
+            boson::yield();
+            if (1 != internal::current_thread()->id())
+              ++nb_migrations;
+          }
+        });
+      }
+    });
+    CHECK(nb_migrations == 0);
+  }
+}
+
+TEST_CASE("Routines - Placement policies", "[routines][placement]") {
+  constexpr int nb_routines = 100;
+  std::unique_ptr<placement_policy> policies[] = {
+      std::make_unique<round_robin_placement>(), std::make_unique<least_loaded_placement>(),
+      std::make_unique<power_of_two_choices_placement>()};
+
+  for (auto& policy : policies) {
+    std::atomic<int> nb_finished{0};
+    {
+      engine instance(3);
+      instance.set_placement_policy(std::move(policy));
+      instance.start([&]() {
+        for (int index = 0; index < nb_routines; ++index) {
+          start([&]() {
+            boson::sleep(std::chrono::milliseconds(1));
+            ++nb_finished;
+          });
+        }
+      });
+    }
+    CHECK(nb_finished == nb_routines);
+  }
+}
+
+TEST_CASE("Routines - Placement choices", "[routines][placement]") {
+  load_weights weights;
+  load_weights custom_weights;
+  custom_weights.runnable = 1;
+  custom_weights.suspended = 10;
+  custom_weights.timers = 5;
+  // Scores are 8, 3 and 1 by default, 2, 30 and 5 with the custom weights
+  thread_loads loads{{{2, 0, 0, 0}, {0, 3, 0, 0}, {0, 0, 1, 0}}};
+
+  SECTION("Least loaded") {
+    CHECK(2 == least_loaded_placement{}.place(loads));
+    CHECK(0 == least_loaded_placement{custom_weights}.place(loads));
+
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<std::size_t> count(0, 8);
+    for (int iteration = 0; iteration < 100; ++iteration) {
+      std::vector<thread_load> random_loads(5);
+      for (auto& load : random_loads)
+        load = {count(generator), count(generator), count(generator), count(generator)};
+      std::size_t min_score = weights.score(random_loads[0]);
+      for (auto& load : random_loads) min_score = std::min(min_score, weights.score(load));
+      thread_id chosen = least_loaded_placement{}.place(thread_loads{random_loads});
+      CHECK(min_score == weights.score(random_loads[chosen]));
+    }
+  }
+
+  SECTION("Power of two choices") {
+    // With two threads, both are always looked at
+    thread_loads busy_first{{{5, 0, 0, 0}, {0, 1, 0, 0}}};
+    thread_loads busy_second{{{0, 1, 0, 0}, {5, 0, 0, 0}}};
+    thread_loads busy_with_custom{{{1, 0, 0, 0}, {0, 2, 0, 0}}};
+    power_of_two_choices_placement policy;
+    power_of_two_choices_placement custom_policy{custom_weights};
+    for (int iteration = 0; iteration < 100; ++iteration) {
+      CHECK(1 == policy.place(busy_first));
+      CHECK(0 == policy.place(busy_second));
+      CHECK(1 == policy.place(busy_with_custom));
+      CHECK(0 == custom_policy.place(busy_with_custom));
+      // The chosen thread is never the busiest of all
+      CHECK(0 != policy.place(loads));
+    }
+  }
+}
+
+TEST_CASE("Routines - Wake up coalescing", "[routines][statistics]") {
+  constexpr int nb_routines = 100;
+  std::atomic<int> nb_finished{0};
+  engine_statistics before, after;
+  boson::run(2, [&]() {
+    thread_id other_thread = 1 - internal::current_thread()->id();
+    // Lets the other thread block in its event loop
+    boson::sleep(std::chrono::milliseconds(20));
+    before = internal::current_thread()->get_engine().statistics();
+    for (int index = 0; index < nb_routines; ++index)
+      start_explicit(other_thread, [&]() { ++nb_finished; });
+    after = internal::current_thread()->get_engine().statistics();
+    while (nb_finished < nb_routines)
+      boson::yield();
+  });
+  // The first command of the burst wakes the thread up, the next ones find it awake
+  std::size_t nb_sent = after.nb_wakeups_sent - before.nb_wakeups_sent;
+  std::size_t nb_saved = after.nb_wakeups_saved - before.nb_wakeups_saved;
+  CHECK(static_cast<std::size_t>(nb_routines) == nb_sent + nb_saved);
+  CHECK(0 < nb_saved);
+  CHECK(nb_sent < static_cast<std::size_t>(nb_routines));
+}
+
+TEST_CASE("Routines - Sub-millisecond timers", "[routines][timers]") {
+  using namespace std::chrono;
+  constexpr int nb_sleeps = 10;
+  high_resolution_clock::duration slept{}, timed_out{};
+  {
+    engine instance(1);
+    instance.set_timer_resolution(timer_resolution::microseconds);
+    // Sleeps are measured with the system clock, the cached one may make them early
+    instance.set_clock_mode(clock_mode::precise);
+    instance.start([&]() {
+      auto start = high_resolution_clock::now();
+      for (int index = 0; index < nb_sleeps; ++index) boson::sleep(300us);
+      slept = high_resolution_clock::now() - start;
+
+      // Any duration type is accepted
+      start = high_resolution_clock::now();
+      int result = select_any(event_timer(500000ns, []() { return 1; }));
+      timed_out = high_resolution_clock::now() - start;
+      CHECK(result == 1);
+    });
+  }
+  CHECK(nb_sleeps * 300us <= slept);
+  CHECK(500us <= timed_out);
+}
+
+TEST_CASE("Routines - Cached clock", "[routines][timers]") {
+  using namespace std::chrono;
+  for (auto mode : {clock_mode::cached, clock_mode::precise}) {
+    bool stable = false;
+    bool advanced = false;
+    {
+      engine instance(1);
+      instance.set_clock_mode(mode);
+      instance.start([&]() {
+        auto first = boson::now();
+        // Busy wait, without going back to the scheduler
+        auto end = high_resolution_clock::now() + 1ms;
+        while (high_resolution_clock::now() < end) {
+        }
+        stable = first == boson::now();
+        boson::sleep(1ms);
+        advanced = first < boson::now();
+      });
+    }
+    CHECK(stable == (clock_mode::cached == mode));
+    CHECK(advanced);
+  }
+}
+
+TEST_CASE("Routines - Busy poll", "[routines][statistics]") {
+  int pipe_fds[2];
+  REQUIRE(0 == ::pipe2(pipe_fds, O_NONBLOCK));
+  engine_statistics statistics;
+  {
+    engine instance(1);
+    instance.set_busy_poll(1s);
+    instance.start([&]() {
+      // The thread spins until the byte comes
+      char byte = 0;
+      CHECK(1 == boson::read(pipe_fds[0], &byte, 1));
+      statistics = instance.statistics();
+    });
+    std::this_thread::sleep_for(10ms);
+    CHECK(1 == ::write(pipe_fds[1], "a", 1));
+  }
+  ::close(pipe_fds[0]);
+  ::close(pipe_fds[1]);
+  CHECK(0 < statistics.nb_busy_poll_hits);
+}
+
+TEST_CASE("Routines - Stack reuse", "[routines][statistics]") {
+  constexpr int nb_routines = 1000;
+  int nb_finished = 0;
+  engine_statistics statistics;
+  boson::run(1, [&]() {
+    for (int index = 0; index < nb_routines; ++index) {
+      start([&]() { ++nb_finished; });
+      if (index % 10 == 0) boson::yield();
+    }
+    while (nb_finished < nb_routines) boson::yield();
+    statistics = internal::current_thread()->get_engine().statistics();
+  });
+  // Finished routines give their stack to the next ones
+  CHECK(0 < statistics.nb_stacks_reused);
+  CHECK(statistics.nb_stacks_mapped < static_cast<std::size_t>(nb_routines));
+}
+
+TEST_CASE("Routines - Stack sizes", "[routines]") {
+  bool small_done = false;
+  bool large_done = false;
+  {
+    engine instance(2);
+    instance.start(thread_id{0}, stack_size::huge, [&]() {
+      // Would overflow the default stack
+      volatile char buffer[512 * 1024];
+      buffer[0] = 1;
+      buffer[sizeof(buffer) - 1] = 1;
+      start(stack_size::small, [&]() { small_done = true; });
+      start_explicit(1, stack_size::large, [&](int value) { large_done = 1 == value; }, 1);
+    });
+  }
+  CHECK(small_done);
+  CHECK(large_done);
+}
+
+TEST_CASE("Routines - Stack overflow detection", "[routines]") {
+  int error_pipe[2];
+  REQUIRE(0 == ::pipe(error_pipe));
+  pid_t child = ::fork();
+  REQUIRE(0 <= child);
+  if (0 == child) {
+    ::dup2(error_pipe[1], STDERR_FILENO);
+    std::signal(SIGABRT, SIG_DFL);  // Not a test failure
+    {
+      boson::engine instance(1);
+      stack_pool_config config;
+      config.protection = stack_protection::guard_page;
+      instance.set_stack_pool_config(config);
+      instance.start([]() { start(stack_size::small, []() { overflow_depth(1); }); });
+    }
+    ::_exit(0);
+  }
+  ::close(error_pipe[1]);
+  std::string errors;
+  char buffer[256];
+  ssize_t nb_read = 0;
+  while (0 < (nb_read = ::read(error_pipe[0], buffer, sizeof(buffer))))
+    errors.append(buffer, nb_read);
+  ::close(error_pipe[0]);
+  int status = 0;
+  ::waitpid(child, &status, 0);
+  CHECK(WIFSIGNALED(status));
+  CHECK(SIGABRT == WTERMSIG(status));
+  CHECK(std::string::npos != errors.find("stack overflow in routine"));
+  CHECK(std::string::npos != errors.find("stack of 16384 bytes"));
+}
+
+TEST_CASE("Routines - Stack usage", "[routines][statistics]") {
+  engine_statistics statistics;
+  {
+    engine instance(2);
+    stack_pool_config config;
+    config.measure_usage = true;
+    instance.set_stack_pool_config(config);
+    for (int index = 0; index < 10; ++index) {
+      instance.start(light_routine{});
+      instance.start(heavy_routine{});
+    }
+    instance.start([&]() {
+      // Usages are recorded when routines finish
+      std::size_t nb_finished = 0;
+      while (nb_finished < 20) {
+        boson::yield();
+        statistics = instance.statistics();
+        nb_finished = 0;
+        for (auto const& usage : statistics.stack_usages) nb_finished += usage.nb_routines;
+      }
+    });
+  }
+  REQUIRE(2 == statistics.stack_usages.size());
+  for (auto const& usage : statistics.stack_usages) {
+    if (std::string::npos != usage.function.find("light_routine")) {
+      CHECK(10 == usage.nb_routines);
+      CHECK(usage.max_bytes < 10 * 1024);
+    } else if (std::string::npos != usage.function.find("heavy_routine")) {
+      CHECK(10 == usage.nb_routines);
+      CHECK(10 * 1024 <= usage.max_bytes);
+      CHECK(10 == usage.histogram[4]);  // Between 8 and 16 KiB
+    }
+  }
+}
+
+TEST_CASE("Routines - Function storage", "[routines]") {
+  auto token = std::make_shared<int>(0);
+  {
+    engine instance(1);
+    // Small enough to be stored in the routine
+    instance.start([token](int value) { *token += value; }, 1);
+    // Stored on the heap
+    std::array<char, 256> big{};
+    big[0] = 2;
+    instance.start([token, big]() { *token += big[0]; });
+  }
+  CHECK(3 == *token);
+  // Captures are destroyed with their routine
+  CHECK(1 == token.use_count());
+}
@@ -2,7 +2,12 @@
 #include "boson/boson.h"
 #include "boson/syscalls.h"
 #include "boson/net/socket.h"
+#include "boson/net/zerocopy.h"
+#include <arpa/inet.h>
 #include <unistd.h>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include "boson/logger.h"
 #include "boson/semaphore.h"
@@ -117,3 +122,399 @@ TEST_CASE("Sockets - Simple accept/connect", "[syscalls][sockets][accept][connec
     });
   }
 }
+
+TEST_CASE("Sockets - io_uring backend", "[syscalls][sockets][io_uring]") {
+  int sockets[2];
+  REQUIRE(0 == ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sockets));
+  engine_statistics statistics;
+  {
+    boson::engine instance(1);
+    instance.set_event_backend(event_backend::io_uring);
+    instance.start([&]() {
+      start([](int fd) {
+        std::uint64_t request = 0;
+        while (0 < boson::read(fd, &request, sizeof(request)))
+          boson::write(fd, &request, sizeof(request));
+        boson::close(fd);
+      }, sockets[1]);
+
+      for (std::uint64_t index = 0; index < 10; ++index) {
+        std::uint64_t reply = 0;
+        CHECK(sizeof(index) == boson::write(sockets[0], &index, sizeof(index)));
+        CHECK(sizeof(reply) == boson::recv(sockets[0], &reply, sizeof(reply), 0));
+        CHECK(index == reply);
+      }
+
+      // Timeouts still apply
+      std::uint64_t reply = 0;
+      CHECK(-1 == boson::read(sockets[0], &reply, sizeof(reply), 1));
+      CHECK(ETIMEDOUT == errno);
+      statistics = instance.statistics();
+      ::shutdown(sockets[0], SHUT_WR);
+    });
+  }
+  ::close(sockets[0]);
+  // Some kernels do not have io_uring, epoll is then used
+  if (0 == statistics.nb_io_operations) WARN("io_uring is not supported by this kernel");
+}
+
+TEST_CASE("Sockets - Listening on all threads", "[syscalls][sockets][accept][connect]") {
+  constexpr int nb_connections = 20;
+  for (auto backend : {event_backend::epoll, event_backend::io_uring}) {
+    for (int domain : {AF_INET, AF_INET6}) {
+      std::atomic<int> nb_served{0};
+      std::atomic<int> nb_moved{0};
+      {
+        boson::engine instance(2);
+        instance.set_event_backend(backend);
+        instance.start([&]() {
+          auto listeners = net::listen_on_all_threads(0, [&](int fd) {
+            // Accepted sockets are non blocking and stay on their thread
+            thread_id accepting_thread = internal::current_thread()->id();
+            char byte = 0;
+            if (0 != (::fcntl(fd, F_GETFL) & O_NONBLOCK) && 1 == boson::read(fd, &byte, 1) &&
+                1 == boson::write(fd, &byte, 1))
+              ++nb_served;
+            if (accepting_thread != internal::current_thread()->id()) ++nb_moved;
+            boson::close(fd);
+          }, domain);
+          int port = net::internal::bound_port(listeners[0]);
+
+          for (int index = 0; index < nb_connections; ++index) {
+            sockaddr_storage address;
+            ::memset(&address, 0, sizeof(address));
+            socklen_t length = 0;
+            if (AF_INET6 == domain) {
+              auto& address6 = reinterpret_cast<sockaddr_in6&>(address);
+              address6.sin6_family = AF_INET6;
+              address6.sin6_addr = in6addr_loopback;
+              address6.sin6_port = htons(port);
+              length = sizeof(address6);
+            } else {
+              auto& address4 = reinterpret_cast<sockaddr_in&>(address);
+              address4.sin_family = AF_INET;
+              address4.sin_addr.s_addr = ::inet_addr("127.0.0.1");
+              address4.sin_port = htons(port);
+              length = sizeof(address4);
+            }
+            int fd = ::socket(domain, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            // REQUIRE would throw through the routine context switch
+            int connected = boson::connect(fd, reinterpret_cast<sockaddr*>(&address), length);
+            CHECK(0 == connected);
+            if (0 != connected) {
+              boson::close(fd);
+              break;
+            }
+            char byte = 'a';
+            CHECK(1 == boson::write(fd, &byte, 1));
+            CHECK(1 == boson::read(fd, &byte, 1));
+            boson::close(fd);
+          }
+
+          // Ends the accept routines
+          for (auto listener : listeners) ::shutdown(listener, SHUT_RDWR);
+        });
+      }
+      CHECK(nb_connections == nb_served);
+      CHECK(0 == nb_moved);
+    }
+  }
+}
+
+TEST_CASE("Sockets - Vectored I/O", "[syscalls][sockets][select]") {
+  std::string header(16, 'h');
+  std::string body(1 << 20, 'b');  // Larger than the socket buffer, writes are partial
+  std::string trailer("end");
+  for (auto backend : {event_backend::epoll, event_backend::io_uring}) {
+    int sockets[2];
+    REQUIRE(0 == ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sockets));
+    ssize_t nb_written = 0;
+    ssize_t nb_sent = 0;
+    ssize_t nb_selected = 0;
+    std::string received;
+    {
+      boson::engine instance(1);
+      instance.set_event_backend(backend);
+      instance.start([&]() {
+        start([&]() {
+          iovec buffers[3] = {{&header[0], header.size()}, {nullptr, 0}, {&body[0], body.size()}};
+          nb_written = boson::writev_all(sockets[0], buffers, 3);
+          iovec message_buffers[2] = {{&header[0], header.size()}, {&body[0], body.size()}};
+          msghdr message{};
+          message.msg_iov = message_buffers;
+          message.msg_iovlen = 2;
+          nb_sent = boson::sendmsg_all(sockets[0], &message, 0);
+          iovec trailer_buffer{&trailer[0], trailer.size()};
+          message.msg_iov = &trailer_buffer;
+          message.msg_iovlen = 1;
+          nb_selected = select_any(
+              event_sendmsg(sockets[0], &message, 0, [](ssize_t nb_sent) { return nb_sent; }));
+          ::shutdown(sockets[0], SHUT_WR);
+        });
+
+        // Every flavour of vectored read, until the end of the stream
+        char first[100];
+        char second[4000];
+        ssize_t nb_read = 0;
+        int index = 0;
+        do {
+          iovec buffers[2] = {{first, sizeof(first)}, {second, sizeof(second)}};
+          msghdr message{};
+          message.msg_iov = buffers;
+          message.msg_iovlen = 2;
+          switch (index++ % 3) {
+            case 0:
+              nb_read = boson::readv(sockets[1], buffers, 2);
+              break;
+            case 1:
+              nb_read = boson::recvmsg(sockets[1], &message, 0);
+              break;
+            default:
+              nb_read = select_any(
+                  event_readv(sockets[1], buffers, 2, [](ssize_t nb_read) { return nb_read; }));
+              break;
+          }
+          if (0 < nb_read) {
+            std::size_t nb_first = std::min<std::size_t>(nb_read, sizeof(first));
+            received.append(first, nb_first);
+            received.append(second, nb_read - nb_first);
+          }
+        } while (0 < nb_read);
+      });
+    }
+    ::close(sockets[0]);
+    ::close(sockets[1]);
+    CHECK(static_cast<ssize_t>(header.size() + body.size()) == nb_written);
+    CHECK(nb_written == nb_sent);
+    CHECK(static_cast<ssize_t>(trailer.size()) == nb_selected);
+    CHECK((header + body + header + body + trailer) == received);
+  }
+}
+
+TEST_CASE("Sockets - Batched datagrams", "[syscalls][sockets][udp]") {
+  constexpr unsigned nb_datagrams = 8;
+  for (auto backend : {event_backend::epoll, event_backend::io_uring}) {
+    int server = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    int client = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    REQUIRE(0 <= server);
+    REQUIRE(0 <= client);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    REQUIRE(0 == ::bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)));
+    REQUIRE(0 == ::bind(client, reinterpret_cast<sockaddr*>(&address), sizeof(address)));
+    socklen_t address_len = sizeof(address);
+    REQUIRE(0 == ::getsockname(server, reinterpret_cast<sockaddr*>(&address), &address_len));
+    sockaddr_in client_address{};
+    address_len = sizeof(client_address);
+    REQUIRE(0 ==
+            ::getsockname(client, reinterpret_cast<sockaddr*>(&client_address), &address_len));
+
+    int nb_sent = 0;
+    int nb_received = 0;
+    std::uint32_t received[nb_datagrams] = {};
+    sockaddr_in reply_address{};
+    std::uint32_t reply = 0;
+    {
+      boson::engine instance(1);
+      instance.set_event_backend(backend);
+      instance.start([&]() {
+        start([&]() {
+          // Waits for the first datagram, then drains every available one
+          std::uint32_t values[nb_datagrams];
+          iovec buffers[nb_datagrams];
+          mmsghdr messages[nb_datagrams];
+          sockaddr_in sources[nb_datagrams];
+          while (nb_received < static_cast<int>(nb_datagrams)) {
+            for (unsigned index = 0; index < nb_datagrams; ++index) {
+              buffers[index] = {&values[index], sizeof(values[index])};
+              messages[index] = mmsghdr{};
+              messages[index].msg_hdr.msg_iov = &buffers[index];
+              messages[index].msg_hdr.msg_iovlen = 1;
+              messages[index].msg_hdr.msg_name = &sources[index];
+              messages[index].msg_hdr.msg_namelen = sizeof(sources[index]);
+            }
+            int nb_messages =
+                boson::recvmmsg(server, messages, nb_datagrams - nb_received, 0, 1000);
+            if (nb_messages <= 0) break;
+            for (int index = 0; index < nb_messages; ++index) {
+              if (sizeof(values[index]) == messages[index].msg_len &&
+                  sources[index].sin_port == client_address.sin_port)
+                received[nb_received] = values[index];
+              ++nb_received;
+            }
+          }
+
+          // Answers the sender of the next datagram
+          std::uint32_t request = 0;
+          sockaddr_in source{};
+          socklen_t source_len = sizeof(source);
+          if (sizeof(request) == boson::recvfrom(server, &request, sizeof(request), 0,
+                                                 reinterpret_cast<sockaddr*>(&source),
+                                                 &source_len, 1000))
+            boson::sendto(server, &request, sizeof(request), 0,
+                          reinterpret_cast<sockaddr*>(&source), source_len);
+        });
+
+        std::uint32_t values[nb_datagrams];
+        iovec buffers[nb_datagrams];
+        mmsghdr messages[nb_datagrams];
+        for (unsigned index = 0; index < nb_datagrams; ++index) {
+          values[index] = index;
+          buffers[index] = {&values[index], sizeof(values[index])};
+          messages[index] = mmsghdr{};
+          messages[index].msg_hdr.msg_iov = &buffers[index];
+          messages[index].msg_hdr.msg_iovlen = 1;
+          messages[index].msg_hdr.msg_name = &address;
+          messages[index].msg_hdr.msg_namelen = sizeof(address);
+        }
+        nb_sent = boson::sendmmsg(client, messages, nb_datagrams, 0);
+
+        std::uint32_t request = 42;
+        boson::sendto(client, &request, sizeof(request), 0, reinterpret_cast<sockaddr*>(&address),
+                      sizeof(address));
+        socklen_t reply_address_len = sizeof(reply_address);
+        boson::recvfrom(client, &reply, sizeof(reply), 0,
+                        reinterpret_cast<sockaddr*>(&reply_address), &reply_address_len, 1000);
+      });
+    }
+    ::close(server);
+    ::close(client);
+    CHECK(static_cast<int>(nb_datagrams) == nb_sent);
+    CHECK(static_cast<int>(nb_datagrams) == nb_received);
+    for (unsigned index = 0; index < nb_datagrams; ++index) CHECK(index == received[index]);
+    CHECK(42u == reply);
+    CHECK(address.sin_port == reply_address.sin_port);
+  }
+}
+
+TEST_CASE("Sockets - Zero copy transfers", "[syscalls][sockets][splice]") {
+  std::string content(1 << 20, 'c');  // Larger than the socket buffers
+  for (std::size_t index = 0; index < content.size(); ++index)
+    content[index] = static_cast<char>(index % 251);
+  std::FILE* file = std::tmpfile();
+  REQUIRE(nullptr != file);
+  REQUIRE(content.size() == std::fwrite(content.data(), 1, content.size(), file));
+  std::fflush(file);
+
+  for (auto backend : {event_backend::epoll, event_backend::io_uring}) {
+    int client[2];
+    int server[2];
+    REQUIRE(0 == ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, client));
+    REQUIRE(0 == ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, server));
+    std::string sent;
+    std::string echoed;
+    int proxy_result = -1;
+    std::string teed[2];
+    {
+      boson::engine instance(1);
+      instance.set_event_backend(backend);
+      instance.start([&]() {
+        // The client sends the file, the server echoes it back through the proxy
+        start([&]() { proxy_result = net::proxy(client[1], server[0]); });
+        start([&]() {
+          char buffer[4096];
+          ssize_t nb_read = 0;
+          while (0 < (nb_read = boson::read(server[1], buffer, sizeof(buffer))))
+            boson::write(server[1], buffer, nb_read);
+          ::shutdown(server[1], SHUT_WR);
+        });
+        start([&]() {
+          off_t offset = 0;
+          while (offset < static_cast<off_t>(content.size()) &&
+                 0 < boson::sendfile(client[0], fileno(file), &offset, content.size() - offset))
+            ;
+          ::shutdown(client[0], SHUT_WR);
+        });
+        char buffer[4096];
+        ssize_t nb_read = 0;
+        while (0 < (nb_read = boson::read(client[0], buffer, sizeof(buffer))))
+          echoed.append(buffer, nb_read);
+
+        // Duplicates the content of a pipe into another one
+        int first[2];
+        int second[2];
+        REQUIRE(0 == ::pipe(first));
+        REQUIRE(0 == ::pipe(second));
+        start([&]() { boson::write(first[1], "tee", 3); });
+        if (3 == boson::tee(first[0], second[1], 3, 0, 1000)) {
+          teed[0].resize(3);
+          teed[1].resize(3);
+          boson::read(first[0], &teed[0][0], 3);
+          boson::read(second[0], &teed[1][0], 3);
+        }
+        for (int fd : {first[0], first[1], second[0], second[1]}) boson::close(fd);
+      });
+    }
+    for (int fd : {client[0], client[1], server[0], server[1]}) ::close(fd);
+    CHECK(0 == proxy_result);
+    CHECK(content == echoed);
+    CHECK("tee" == teed[0]);
+    CHECK("tee" == teed[1]);
+  }
+  std::fclose(file);
+}
+
+TEST_CASE("Sockets - Zero copy sends", "[syscalls][sockets][zerocopy]") {
+  std::string content(1 << 20, 'z');  // Larger than the socket buffers
+  for (std::size_t index = 0; index < content.size(); ++index)
+    content[index] = static_cast<char>(index % 253);
+  constexpr std::size_t chunk_size = 1 << 16;
+  for (auto backend : {event_backend::epoll, event_backend::io_uring}) {
+    std::string received;
+    ssize_t reply_size = -1;
+    bool replied = false;
+    int wait_result = -1;
+    bool all_released = false;
+    {
+      boson::engine instance(1);
+      instance.set_event_backend(backend);
+      instance.start([&]() {
+        socket_t listener = net::create_listening_socket(0);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(net::internal::bound_port(listener));
+        int client = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        REQUIRE(0 == boson::connect(client, reinterpret_cast<sockaddr*>(&address),
+                                    sizeof(address)));
+        int server = boson::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK);
+        REQUIRE(0 <= server);
+
+        start([&]() {
+          char buffer[4096];
+          ssize_t nb_read = 0;
+          while (received.size() < content.size() &&
+                 0 < (nb_read = boson::read(server, buffer, sizeof(buffer))))
+            received.append(buffer, nb_read);
+          boson::write(server, "r", 1);
+        });
+
+        // Completions must not interrupt a reader of the sending socket
+        start([&]() {
+          char reply = 0;
+          reply_size = boson::recv(client, &reply, 1, 0);
+          replied = true;
+        });
+
+        net::zerocopy_sender sender(client);
+        for (std::size_t offset = 0; offset < content.size();) {
+          ssize_t nb_sent = sender.send(content.data() + offset,
+                                        std::min(chunk_size, content.size() - offset));
+          if (nb_sent <= 0) break;
+          offset += nb_sent;
+        }
+        wait_result = sender.wait_all(1000);
+        all_released = sender.released(sender.last_id());
+        while (!replied) boson::yield();
+        boson::close(client);
+        boson::close(server);
+        boson::close(listener);
+      });
+    }
+    CHECK(content == received);
+    CHECK(1 == reply_size);
+    CHECK(0 == wait_result);
+    CHECK(all_released);
+  }
+}
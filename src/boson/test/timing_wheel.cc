@@ -0,0 +1,113 @@
+#include "boson/internal/timing_wheel.h"
+#include <map>
+#include <random>
+#include <vector>
+#include "catch.hpp"
+
+using boson::internal::timing_wheel;
+
+TEST_CASE("Timing wheel - Expiry and cancel", "[timing_wheel]") {
+  timing_wheel wheel(1000);
+  CHECK(wheel.empty());
+
+  auto first = wheel.insert(1010, 1);
+  wheel.insert(1010, 2);
+  wheel.insert(1200, 3);                 // Second level
+  wheel.insert(1000 + (1 << 20), 4);     // Fourth level
+  wheel.insert(1000 + (1ull << 30), 5);  // Overflow
+  wheel.insert(500, 6);                  // Already late
+  CHECK(wheel.size() == 6);
+  CHECK(wheel.next_expiry() == 1000);
+
+  std::vector<std::size_t> expired;
+  auto collect = [&expired](std::size_t value) { expired.push_back(value); };
+  wheel.advance(1009, collect);
+  CHECK(expired == std::vector<std::size_t>{6});
+  CHECK(wheel.next_expiry() == 1010);
+
+  // Cancel really removes the timer
+  wheel.cancel(first);
+  CHECK(wheel.size() == 4);
+  expired.clear();
+  wheel.advance(1199, collect);
+  CHECK(expired == std::vector<std::size_t>{2});
+  CHECK(wheel.next_expiry() <= 1200);
+
+  expired.clear();
+  wheel.advance(1200, collect);
+  CHECK(expired == std::vector<std::size_t>{3});
+
+  // Far timers cascade down to the first level
+  expired.clear();
+  wheel.advance(1000 + (1 << 20) - 1, collect);
+  CHECK(expired.empty());
+  wheel.advance(1000 + (1 << 20), collect);
+  CHECK(expired == std::vector<std::size_t>{4});
+
+  expired.clear();
+  wheel.advance(1000 + (1ull << 30), collect);
+  CHECK(expired == std::vector<std::size_t>{5});
+  CHECK(wheel.empty());
+}
+
+TEST_CASE("Timing wheel - Callbacks", "[timing_wheel]") {
+  timing_wheel wheel(0);
+  std::vector<timing_wheel::handle_t> handles;
+  handles.push_back(wheel.insert(10, 0));
+  handles.push_back(wheel.insert(10, 1));
+  std::vector<std::size_t> expired;
+  wheel.advance(10, [&](std::size_t value) {
+    expired.push_back(value);
+    // The first one cancels its neighbor and adds two timers
+    if (0 == value) {
+      wheel.cancel(handles[1]);
+      wheel.insert(5, 2);
+      wheel.insert(11, 3);
+    }
+  });
+  // Late timers added while expiring wait for the next call
+  CHECK(expired == std::vector<std::size_t>{0});
+  CHECK(wheel.next_expiry() == 10);
+  wheel.advance(10, [&](std::size_t value) { expired.push_back(value); });
+  CHECK((expired == std::vector<std::size_t>{0, 2}));
+  wheel.advance(11, [&](std::size_t value) { expired.push_back(value); });
+  CHECK((expired == std::vector<std::size_t>{0, 2, 3}));
+  CHECK(wheel.empty());
+}
+
+TEST_CASE("Timing wheel - Random schedule", "[timing_wheel]") {
+  std::minstd_rand generator{42};
+  timing_wheel::tick_t now = 123456;
+  timing_wheel wheel(now);
+  std::map<std::size_t, std::pair<timing_wheel::tick_t, timing_wheel::handle_t>> pending;
+  std::size_t next_value = 0;
+  bool ordered = true;
+
+  for (int step = 0; step < 2000; ++step) {
+    for (int index = 0; index < 8; ++index) {
+      // Mix of short and long delays, to exercise every level
+      timing_wheel::tick_t delay = generator() % (1u << (4 * (1 + generator() % 6)));
+      auto deadline = now + delay;
+      pending[next_value] = {deadline, wheel.insert(deadline, next_value)};
+      ++next_value;
+    }
+    if (!pending.empty() && 0 == generator() % 2) {
+      auto victim = pending.lower_bound(generator() % next_value);
+      if (victim != end(pending)) {
+        wheel.cancel(victim->second.second);
+        pending.erase(victim);
+      }
+    }
+    now += generator() % (0 == step % 100 ? 1u << 20 : 64u);
+    wheel.advance(now, [&](std::size_t value) {
+      auto found = pending.find(value);
+      ordered &= found != end(pending) && found->second.first <= now;
+      if (found != end(pending)) pending.erase(found);
+    });
+    // Every timer left is in the future, and next_expiry never overshoots
+    for (auto& timer : pending)
+      ordered &= now < timer.second.first && wheel.next_expiry() <= timer.second.first;
+  }
+  CHECK(ordered);
+  CHECK(wheel.size() == pending.size());
+}
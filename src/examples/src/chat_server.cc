@@ -61,18 +61,18 @@ int main(int argc, char *argv[]) {
       int conn = 0;
       std::string message;
       select_any(                                                     //
-          event_accept(sockfd, (struct sockaddr*)&cli_addr, &clilen,  //
-                       [&](int conn) {                                //
-                         if (0 <= conn) {
-                           std::cout << "Opening connection on " << conn << std::endl;
-                           ::fcntl(conn, F_SETFL, ::fcntl(conn, F_GETFD) | O_NONBLOCK);
-                           conns.insert(conn);
-                           start(listen_client{}, conn, messages, close_connection);
-                           broadcast_message(conns, fmt::format("Client {} joined.\n", conn));
-                         } else if (errno != EAGAIN) {
-                           exit = true;
-                         }
-                       }),
+          event_accept4(sockfd, (struct sockaddr*)&cli_addr, &clilen,  //
+                        SOCK_NONBLOCK | SOCK_CLOEXEC,                  //
+                        [&](int conn) {                                //
+                          if (0 <= conn) {
+                            std::cout << "Opening connection on " << conn << std::endl;
+                            conns.insert(conn);
+                            start(listen_client{}, conn, messages, close_connection);
+                            broadcast_message(conns, fmt::format("Client {} joined.\n", conn));
+                          } else if (errno != EAGAIN) {
+                            exit = true;
+                          }
+                        }),
           event_read(0, buffer.data(), buffer.size(),  // Listen stdin
                      [&](ssize_t nread) {
                        std::string data(buffer.data(), nread - 1);
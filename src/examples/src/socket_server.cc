@@ -21,18 +21,11 @@ int main(int argc, char *argv[]) {
   // Set global logger
   boson::debug::logger_instance(&std::cout);
 
-  // Execute a routine communication through channels
-  boson::run(1, []() {
-    using namespace boson;
-    int sockfd = net::create_listening_socket(8080);
-
-    int newsockfd = -1;
-    struct sockaddr_in cli_addr;
-    socklen_t clilen;
-    clilen = sizeof(cli_addr);
-    while ((newsockfd = boson::accept(sockfd, (struct sockaddr *)&cli_addr, &clilen))) {
+  // Each thread accepts and serves its own share of the connections
+  boson::run(4, []() {
+    boson::net::listen_on_all_threads(8080, [](int newsockfd) {
       std::cout << "Opening connection on " << newsockfd << std::endl;
-      start(listen_client, newsockfd);
-    }
+      listen_client(newsockfd);
+    });
   });
 }